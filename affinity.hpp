@@ -0,0 +1,106 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <string_view>
+#include <vector>
+
+#include <cstdint>
+
+#include <sched.h>
+
+// Placement of worker threads without taskset or root: a thread pins itself to
+// its CPU of a list, then pages it touches first (its tables and input slices)
+// are allocated on the NUMA node of that CPU by the default local policy
+
+// "0-3,8,10-11" into CPUs in the order of the list; false for a malformed list
+// or CPUs the process is not allowed to run on
+inline bool parseCpuList(std::string_view list, std::vector<int> & cpus)
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof allowed, &allowed) != 0) {
+        return false;
+    }
+    auto parseCpu = [&](int & cpu) {
+        auto [ptr, ec] = std::from_chars(list.data(),
+                                         list.data() + list.size(), cpu);
+        if ((ec != std::errc{}) || (cpu < 0) || (cpu >= CPU_SETSIZE)) {
+            return false;
+        }
+        list.remove_prefix(std::size_t(ptr - list.data()));
+        return true;
+    };
+    while (!list.empty()) {
+        int first = 0;
+        if (!parseCpu(first)) {
+            return false;
+        }
+        int last = first;
+        if (!list.empty() && (list.front() == '-')) {
+            list.remove_prefix(1);
+            if (!parseCpu(last) || (last < first)) {
+                return false;
+            }
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            if (!CPU_ISSET(cpu, &allowed)) {
+                return false;
+            }
+            cpus.push_back(cpu);
+        }
+        if (!list.empty()) {
+            if (list.front() != ',') {
+                return false;
+            }
+            list.remove_prefix(1);
+        }
+    }
+    return !cpus.empty();
+}
+
+// pins the calling thread
+inline bool pinThread(int cpu)
+{
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(cpu, &cpuSet);
+    return sched_setaffinity(0, sizeof cpuSet, &cpuSet) == 0;
+}
+
+struct Placement
+{
+    int cpu = -1;
+    int node = -1;
+};
+
+// where the calling thread runs now
+inline Placement getPlacement()
+{
+    unsigned int cpu = 0;
+    unsigned int node = 0;
+    if (getcpu(&cpu, &node) != 0) {
+        return {};
+    }
+    return {int(cpu), int(node)};
+}
+
+// Touches the pages of the part of thread out of threadCount equal parts of
+// [beg, end) first, so that they are allocated on its node; contents are kept
+inline void touchPages(char * beg, char * end, std::size_t thread = 0,
+                       std::size_t threadCount = 1)
+{
+    constexpr std::uintptr_t kPageSize = 4096;
+    auto first = reinterpret_cast<std::uintptr_t>(beg);
+    auto last = reinterpret_cast<std::uintptr_t>(end);
+    auto base = first / kPageSize * kPageSize;
+    auto pageCount = (last - base + kPageSize - 1) / kPageSize;
+    for (auto page = pageCount * thread / threadCount;
+         page < pageCount * (thread + 1) / threadCount; ++page)
+    {
+        // the first page can start before beg
+        auto p = reinterpret_cast<volatile char *>(
+            std::max(base + page * kPageSize, first));
+        *p = *p;
+    }
+}
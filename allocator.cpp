@@ -0,0 +1,157 @@
+#include "memory.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+#include <cstdlib>
+
+namespace
+{
+// every block is prefixed by its size, header keeps fundamental alignment
+constexpr std::size_t kHeaderSize = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+std::atomic<std::size_t> allocatedBytes{0};
+std::atomic<std::size_t> peakAllocatedBytes{0};
+std::atomic<std::size_t> allocatedCount{0};
+std::atomic<std::size_t> allocationCount{0};
+
+void onAllocate(std::size_t size)
+{
+    std::size_t current =
+        allocatedBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    std::size_t peak = peakAllocatedBytes.load(std::memory_order_relaxed);
+    while (peak < current &&
+           !peakAllocatedBytes.compare_exchange_weak(
+               peak, current, std::memory_order_relaxed))
+    {
+    }
+    allocatedCount.fetch_add(1, std::memory_order_relaxed);
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void onDeallocate(std::size_t size)
+{
+    allocatedBytes.fetch_sub(size, std::memory_order_relaxed);
+    allocatedCount.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void * allocate(std::size_t size, std::size_t alignment)
+{
+    std::size_t headerSize = std::max(kHeaderSize, alignment);
+    void * base = nullptr;
+    if (alignment > kHeaderSize) {
+        if (posix_memalign(&base, alignment, headerSize + size) != 0) {
+            base = nullptr;
+        }
+    } else {
+        base = std::malloc(headerSize + size);
+    }
+    if (!base) {
+        return nullptr;
+    }
+    auto p = static_cast<char *>(base) + headerSize;
+    reinterpret_cast<std::size_t *>(p)[-1] = size;
+    onAllocate(size);
+    return p;
+}
+
+void deallocate(void * p, std::size_t alignment) noexcept
+{
+    if (!p) {
+        return;
+    }
+    onDeallocate(static_cast<std::size_t *>(p)[-1]);
+    std::free(static_cast<char *>(p) - std::max(kHeaderSize, alignment));
+}
+
+void * allocateOrThrow(std::size_t size, std::size_t alignment)
+{
+    if (void * p = allocate(size, alignment)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+}  // namespace
+
+AllocationStats AllocationStats::current()
+{
+    return {
+        .bytes = allocatedBytes.load(std::memory_order_relaxed),
+        .peakBytes = peakAllocatedBytes.load(std::memory_order_relaxed),
+        .count = allocatedCount.load(std::memory_order_relaxed),
+        .totalCount = allocationCount.load(std::memory_order_relaxed),
+    };
+}
+
+void * operator new(std::size_t size)
+{
+    return allocateOrThrow(size, kHeaderSize);
+}
+
+void * operator new[](std::size_t size)
+{
+    return allocateOrThrow(size, kHeaderSize);
+}
+
+void * operator new(std::size_t size, std::align_val_t alignment)
+{
+    return allocateOrThrow(size, std::size_t(alignment));
+}
+
+void * operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return allocateOrThrow(size, std::size_t(alignment));
+}
+
+void * operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size, kHeaderSize);
+}
+
+void * operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size, kHeaderSize);
+}
+
+void operator delete(void * p) noexcept
+{
+    deallocate(p, kHeaderSize);
+}
+
+void operator delete[](void * p) noexcept
+{
+    deallocate(p, kHeaderSize);
+}
+
+void operator delete(void * p, std::size_t) noexcept
+{
+    deallocate(p, kHeaderSize);
+}
+
+void operator delete[](void * p, std::size_t) noexcept
+{
+    deallocate(p, kHeaderSize);
+}
+
+void operator delete(void * p, std::align_val_t alignment) noexcept
+{
+    deallocate(p, std::size_t(alignment));
+}
+
+void operator delete[](void * p, std::align_val_t alignment) noexcept
+{
+    deallocate(p, std::size_t(alignment));
+}
+
+void operator delete(void * p, std::size_t, std::align_val_t alignment) noexcept
+{
+    deallocate(p, std::size_t(alignment));
+}
+
+void operator delete[](void * p, std::size_t,
+                       std::align_val_t alignment) noexcept
+{
+    deallocate(p, std::size_t(alignment));
+}
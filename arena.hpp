@@ -0,0 +1,309 @@
+#pragma once
+
+#include "charclass.hpp"
+#include "helpers.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <string_view>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <sys/mman.h>
+
+// Arena of unique words growing by segments: address space for all segments
+// is reserved at once, a segment is made accessible on demand, so a word is
+// referred to by the 16-byte granule of its record from the start of the
+// arena, which fits into kReferenceBits. A record is the 32-bit length of the
+// word, its bytes and NUL, zero-padded to 16 bytes, and does not cross
+// segments. Reference 0 is never given to a word. Trivial, so that tables it
+// is embedded in stay mappable by mapZeroed(), thus memory is unmapped by
+// release() rather than by a destructor.
+template<uint32_t kReferenceBits = 32>
+struct WordArena
+{
+    static_assert(kReferenceBits <= 32);
+
+    static constexpr std::size_t kGranuleSize = sizeof(__m128i);
+    static constexpr uint32_t kSegmentOrder = 26;  // 64 MiB
+    static constexpr std::size_t kSegmentSize = std::size_t(1) << kSegmentOrder;
+    static constexpr uint32_t kGranuleOrder = kSegmentOrder - 4;
+    static constexpr uint64_t kGranuleMask = (uint64_t(1) << kGranuleOrder) - 1;
+    static constexpr std::size_t kMaxSegmentCount = std::size_t(1)
+                                                    << (kReferenceBits -
+                                                        kGranuleOrder);
+
+    static_assert((std::size_t(1) << (kSegmentOrder - kGranuleOrder)) ==
+                  kGranuleSize);
+
+    char * base;  // reserved address space of kMaxSegmentCount segments
+    bool mapped[kMaxSegmentCount];  // segment is accessible
+    uint64_t top;  // reference of the next record, beyond the last segment if
+                   // the arena is full
+    bool full;  // a word was not stored
+
+    // the arena is full from the start if address space is exhausted
+    void init()
+    {
+        void * p = mmap(nullptr, kMaxSegmentCount * kSegmentSize, PROT_NONE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        base = (p == MAP_FAILED) ? nullptr : static_cast<char *>(p);
+        std::fill(std::begin(mapped), std::end(mapped), false);
+        top = 1;
+        full = !base;
+    }
+
+    void release()
+    {
+        if (base) {
+            munmap(base, kMaxSegmentCount * kSegmentSize);
+            base = nullptr;
+        }
+    }
+
+    // forgets all words, segments stay mapped; bytes in use are zero-filled,
+    // since gaps between records should be
+    void clear()
+    {
+        uint64_t size = getSize();
+        for (std::size_t segment = 0; size != 0; ++segment) {
+            auto segmentSize = std::min<uint64_t>(size, kSegmentSize);
+            if (mapped[segment]) {
+                std::fill_n(getSegment(segment), segmentSize, '\0');
+            }
+            size -= segmentSize;
+        }
+        top = 1;
+        full = !base;
+    }
+
+    bool isFull() const
+    {
+        return full;
+    }
+
+    // isFull() while other threads reserve records
+    bool isFullShared()
+    {
+        return std::atomic_ref<bool>{full}.load(std::memory_order_relaxed);
+    }
+
+    // bytes of mapped segments
+    std::size_t getCapacity() const
+    {
+        auto segmentCount =
+            std::count(std::cbegin(mapped), std::cend(mapped), true);
+        return std::size_t(segmentCount) * kSegmentSize;
+    }
+
+    // stores a word, returns its reference or 0 if the arena is full
+    uint32_t append(const char * word, uint32_t len)
+    {
+        uint64_t size = getRecordGranules(len);
+        uint64_t reference = top;
+        if (((reference & kGranuleMask) + size) > (kGranuleMask + 1)) {
+            // records do not cross segments
+            reference = (reference | kGranuleMask) + 1;
+        }
+        uint64_t segment = reference >> kGranuleOrder;
+        if UNLIKELY ((size > kGranuleMask) || (segment >= kMaxSegmentCount) ||
+                     (!mapped[segment] && !mapSegment(segment)))
+        {
+            full = true;
+            return 0;
+        }
+        top = reference + size;
+        writeRecord(uint32_t(reference), word, len);
+        return uint32_t(reference);
+    }
+
+    // thread-safe reservation of a record for a word of len bytes, which is
+    // written by writeRecord() then; returns 0 if the arena is full
+    uint32_t reserveShared(uint32_t len)
+    {
+        uint64_t size = getRecordGranules(len);
+        if UNLIKELY (size > kGranuleMask) {
+            std::atomic_ref<bool>{full}.store(true, std::memory_order_relaxed);
+            return 0;
+        }
+        for (;;) {
+            uint64_t reference = std::atomic_ref<uint64_t>{top}.fetch_add(
+                size, std::memory_order_relaxed);
+            if (((reference & kGranuleMask) + size) > (kGranuleMask + 1)) {
+                // the rest of the segment is left unused, the next reservation
+                // gets the next segment
+                continue;
+            }
+            uint64_t segment = reference >> kGranuleOrder;
+            if UNLIKELY ((segment >= kMaxSegmentCount) ||
+                         !mapSegmentShared(segment))
+            {
+                std::atomic_ref<bool>{full}.store(true,
+                                                  std::memory_order_relaxed);
+                return 0;
+            }
+            return uint32_t(reference);
+        }
+    }
+
+    void writeRecord(uint32_t reference, const char * word, uint32_t len)
+    {
+        char * record = getRecord(reference);
+        std::memcpy(record, &len, sizeof len);
+        std::copy_n(word, len, std::next(record, sizeof len));
+    }
+
+    // NUL-terminated
+    const char * getData(uint32_t reference) const
+    {
+        return std::next(getRecord(reference), sizeof(uint32_t));
+    }
+
+    uint32_t getLength(uint32_t reference) const
+    {
+        uint32_t len;
+        std::memcpy(&len, getRecord(reference), sizeof len);
+        return len;
+    }
+
+    std::string_view getWord(uint32_t reference) const
+    {
+        return {getData(reference), getLength(reference)};
+    }
+
+    // word[len] should be NUL: comparison of terminators is faster than a
+    // comparison of lengths in front of bytes
+    bool isEqual(uint32_t reference, const char * word, uint32_t len) const
+    {
+        return std::equal(word, std::next(word, len + 1), getData(reference));
+    }
+
+    // toLower<CharClass>() of every record as a whole, lengths are kept
+    template<typename CharClass>
+    void toLower()
+    {
+        forEachRecord([](char * record, uint32_t len) {
+            auto size = getRecordGranules(len) * kGranuleSize;
+            ::toLower<CharClass>(record,
+                                 std::next(record, std::ptrdiff_t(size)));
+            std::memcpy(record, &len, sizeof len);
+        });
+    }
+
+    // bytes of segments in use, for a snapshot
+    uint64_t getSize() const
+    {
+        uint64_t used = std::min<uint64_t>(top, uint64_t(kMaxSegmentCount)
+                                                    << kGranuleOrder);
+        return used * kGranuleSize;
+    }
+
+    // the used part of segments, restored by read()
+    bool write(std::FILE * file) const
+    {
+        uint64_t size = getSize();
+        if (std::fwrite(&top, sizeof top, 1, file) != 1) {
+            return false;
+        }
+        for (std::size_t segment = 0; size != 0; ++segment) {
+            auto segmentSize = std::min<uint64_t>(size, kSegmentSize);
+            if (mapped[segment]) {
+                if (std::fwrite(getSegment(segment), 1, segmentSize, file) !=
+                    segmentSize)
+                {
+                    return false;
+                }
+            } else if (std::fseek(file, long(segmentSize), SEEK_CUR) != 0) {
+                return false;
+            }
+            size -= segmentSize;
+        }
+        return true;
+    }
+
+    // the arena should not be in use, addresses of an image are not valid
+    bool read(std::FILE * file)
+    {
+        init();
+        if (std::fread(&top, sizeof top, 1, file) != 1) {
+            return false;
+        }
+        uint64_t size = getSize();
+        for (std::size_t segment = 0; size != 0; ++segment) {
+            auto segmentSize = std::min<uint64_t>(size, kSegmentSize);
+            if (!mapSegment(segment) ||
+                (std::fread(getSegment(segment), 1, segmentSize, file) !=
+                 segmentSize))
+            {
+                return false;
+            }
+            size -= segmentSize;
+        }
+        return true;
+    }
+
+private:
+    static uint64_t getRecordGranules(uint32_t len)
+    {
+        return (sizeof len + uint64_t(len) + 1 + kGranuleSize - 1) /
+               kGranuleSize;
+    }
+
+    char * getSegment(uint64_t segment) const
+    {
+        return std::next(base, std::ptrdiff_t(segment * kSegmentSize));
+    }
+
+    char * getRecord(uint32_t reference) const
+    {
+        return std::next(base, std::ptrdiff_t(reference * kGranuleSize));
+    }
+
+    bool mapSegment(uint64_t segment)
+    {
+        mapped[segment] = base && (mprotect(getSegment(segment), kSegmentSize,
+                                            PROT_READ | PROT_WRITE) == 0);
+        return mapped[segment];
+    }
+
+    // mprotect() of a segment by several threads at once is harmless
+    bool mapSegmentShared(uint64_t segment)
+    {
+        std::atomic_ref<bool> mappedRef{mapped[segment]};
+        if (mappedRef.load(std::memory_order_acquire)) {
+            return true;
+        }
+        if (!base || (mprotect(getSegment(segment), kSegmentSize,
+                               PROT_READ | PROT_WRITE) != 0))
+        {
+            return false;
+        }
+        mappedRef.store(true, std::memory_order_release);
+        return true;
+    }
+
+    // onRecord(record, len) for every record, gaps are zero-filled
+    template<typename OnRecord>
+    void forEachRecord(OnRecord && onRecord)
+    {
+        uint64_t end = getSize() / kGranuleSize;
+        for (uint64_t reference = 1; reference < end;) {
+            if (!mapped[reference >> kGranuleOrder]) {
+                reference = (reference | kGranuleMask) + 1;
+                continue;
+            }
+            char * record = getRecord(uint32_t(reference));
+            uint32_t len;
+            std::memcpy(&len, record, sizeof len);
+            if (len == 0) {
+                ++reference;
+                continue;
+            }
+            onRecord(record, len);
+            reference += getRecordGranules(len);
+        }
+    }
+};
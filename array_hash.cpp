@@ -1,6 +1,7 @@
 #include "common.hpp"
 
 #include "helpers.hpp"
+#include "memory.hpp"
 #include "timer.hpp"
 
 #include <tsl/array_map.h>
@@ -53,6 +54,7 @@ int main(int argc, char * argv[])
 
     timer.report("make input lowercase");
 
+    auto allocationStats = AllocationStats::current();
     tsl::array_map<char, uint32_t> wordCounts;
 
     auto isAlpha = [](char c) {
@@ -68,6 +70,8 @@ int main(int argc, char * argv[])
 
     timer.report(fmt::format(fg(fmt::color::dark_blue), "count words"));
 
+    reportAllocations(allocationStats, wordCounts.size());
+
     std::vector<std::pair<std::string_view, uint32_t>> output;
     output.reserve(wordCounts.size());
     for(auto it = wordCounts.cbegin(); it != wordCounts.cend(); ++it) {
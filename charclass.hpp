@@ -0,0 +1,261 @@
+#pragma once
+
+#include "helpers.hpp"
+
+#include <array>
+#include <iterator>
+#include <type_traits>
+
+#include <cassert>
+#include <cstdint>
+
+// Word definitions: a word is a maximal run of bytes of the class after ASCII
+// lowercasing, "inner" bytes belong to a word only if both of their neighbours
+// are bytes of the class
+namespace charclass
+{
+
+struct Alpha
+{
+    static constexpr bool isWord(uint8_t c)
+    {
+        return (c >= 'a') && (c <= 'z');
+    }
+
+    static constexpr bool isInner(uint8_t)
+    {
+        return false;
+    }
+};
+
+struct Alnum
+{
+    static constexpr bool isWord(uint8_t c)
+    {
+        return Alpha::isWord(c) || ((c >= '0') && (c <= '9'));
+    }
+
+    static constexpr bool isInner(uint8_t)
+    {
+        return false;
+    }
+};
+
+struct Identifier
+{
+    static constexpr bool isWord(uint8_t c)
+    {
+        return Alnum::isWord(c) || (c == '_');
+    }
+
+    static constexpr bool isInner(uint8_t)
+    {
+        return false;
+    }
+};
+
+// "don't", "o'clock", but not "'quoted'"
+struct Apostrophe
+{
+    static constexpr bool isWord(uint8_t c)
+    {
+        return Alpha::isWord(c);
+    }
+
+    static constexpr bool isInner(uint8_t c)
+    {
+        return c == '\'';
+    }
+};
+
+constexpr uint8_t kWord = 1 << 0;
+constexpr uint8_t kInner = 1 << 1;
+
+constexpr uint8_t toLowerAscii(uint8_t c)
+{
+    return ((c >= 'A') && (c <= 'Z')) ? uint8_t(c + ('a' - 'A')) : c;
+}
+
+// kWord and kInner flags of every byte, indexed by byte as is
+template<typename CharClass>
+inline constexpr std::array<uint8_t, 256> kTable = [] {
+    std::array<uint8_t, 256> table = {};
+    for (std::size_t c = 0; c < table.size(); ++c) {
+        uint8_t lowercase = toLowerAscii(uint8_t(c));
+        if (CharClass::isWord(lowercase)) {
+            table[c] = kWord;
+        } else if (CharClass::isInner(lowercase)) {
+            table[c] = kInner;
+        }
+    }
+    return table;
+}();
+
+// Byte c is of a class iff (low[c & 0xF] & high[c >> 4] & classBits) != 0:
+// every distinct non-empty row of the 16x16 table gets its own bit
+struct NibbleTables
+{
+    uint8_t low[16] = {};
+    uint8_t high[16] = {};
+    uint8_t wordBits = 0;
+    uint8_t innerBits = 0;
+};
+
+template<typename CharClass>
+constexpr NibbleTables makeNibbleTables()
+{
+    NibbleTables tables;
+    uint16_t rows[8] = {};
+    uint8_t rowFlags[8] = {};
+    uint32_t rowCount = 0;
+    for (uint8_t flag : {kWord, kInner}) {
+        for (uint32_t high = 0; high < 16; ++high) {
+            uint16_t row = 0;
+            for (uint32_t low = 0; low < 16; ++low) {
+                if ((kTable<CharClass>[high * 16 + low] & flag) != 0) {
+                    row |= uint16_t(1u << low);
+                }
+            }
+            if (row == 0) {
+                continue;
+            }
+            uint32_t bit = 0;
+            while ((bit < rowCount) &&
+                   ((rows[bit] != row) || (rowFlags[bit] != flag)))
+            {
+                ++bit;
+            }
+            if (bit == rowCount) {
+                if (rowCount == std::size(rows)) {
+                    throw "character class is too irregular";
+                }
+                rows[rowCount] = row;
+                rowFlags[rowCount] = flag;
+                ++rowCount;
+            }
+            tables.high[high] |= uint8_t(1u << bit);
+            for (uint32_t low = 0; low < 16; ++low) {
+                if ((row & (1u << low)) != 0) {
+                    tables.low[low] |= uint8_t(1u << bit);
+                }
+            }
+            (flag == kWord ? tables.wordBits : tables.innerBits) |=
+                uint8_t(1u << bit);
+        }
+    }
+    return tables;
+}
+
+template<typename CharClass>
+inline constexpr NibbleTables kNibbleTables = makeNibbleTables<CharClass>();
+
+template<typename CharClass>
+inline constexpr bool kHasInner = (kNibbleTables<CharClass>.innerBits != 0);
+
+inline __m128i loadTable(const uint8_t (&table)[16])
+{
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(table));
+}
+
+// Classifies consecutive 16-byte blocks: bits of separators of a block depend
+// on the last byte of the previous block and the first byte of the next one if
+// the class has inner bytes
+template<typename CharClass>
+class Classifier
+{
+public:
+    // lowercase is str with [A-Z] made lowercase, separators are not specified
+    static FORCEINLINE __m128i separatorMask(__m128i str, __m128i & lowercase)
+    {
+        if constexpr (std::is_same_v<CharClass, Alpha>) {
+            lowercase = _mm_add_epi8(
+                str, _mm_and_si128(_mm_cmplt_epi8(str, _mm_set1_epi8('a')),
+                                   _mm_set1_epi8('a' - 'A')));
+            return _mm_or_si128(_mm_cmplt_epi8(lowercase, _mm_set1_epi8('a')),
+                                _mm_cmpgt_epi8(lowercase, _mm_set1_epi8('z')));
+        } else {
+            __m128i offset = _mm_sub_epi8(str, _mm_set1_epi8('A'));
+            __m128i isUpper = _mm_cmpeq_epi8(
+                _mm_min_epu8(offset, _mm_set1_epi8('Z' - 'A')), offset);
+            lowercase = _mm_add_epi8(
+                str, _mm_and_si128(isUpper, _mm_set1_epi8('a' - 'A')));
+            return _mm_cmpeq_epi8(
+                _mm_and_si128(classBits(lowercase),
+                              _mm_set1_epi8(char(kTables.wordBits))),
+                _mm_setzero_si128());
+        }
+    }
+
+    // bits of separators of the block at i, inner bytes are resolved
+    FORCEINLINE uint32_t operator()(__m128i str, __m128i & lowercase,
+                                    const char * i, const char * end)
+    {
+        uint32_t separators =
+            uint32_t(_mm_movemask_epi8(separatorMask(str, lowercase)));
+        if constexpr (kHasInner<CharClass>) {
+            __m128i inner = _mm_cmpeq_epi8(
+                _mm_and_si128(classBits(lowercase),
+                              _mm_set1_epi8(char(kTables.innerBits))),
+                _mm_set1_epi8(char(kTables.innerBits)));
+            uint32_t word = ~separators & 0xFFFF;
+            uint32_t next = 0;
+            if (std::distance(i, end) > std::ptrdiff_t(sizeof(__m128i))) {
+                next = kTable<CharClass>[uint8_t(i[sizeof(__m128i)])] & kWord;
+            }
+            separators &= ~(uint32_t(_mm_movemask_epi8(inner)) &
+                            ((word << 1) | previousIsWord) &
+                            ((word >> 1) | (next << 15)));
+            previousIsWord = word >> 15;
+        }
+        return separators;
+    }
+
+private:
+    static constexpr NibbleTables kTables = kNibbleTables<CharClass>;
+
+    uint32_t previousIsWord = 0;
+
+    static FORCEINLINE __m128i classBits(__m128i str)
+    {
+        __m128i lowNibbles = _mm_and_si128(str, _mm_set1_epi8(0x0F));
+        __m128i highNibbles =
+            _mm_and_si128(_mm_srli_epi16(str, 4), _mm_set1_epi8(0x0F));
+        return _mm_and_si128(
+            _mm_shuffle_epi8(loadTable(kTables.low), lowNibbles),
+            _mm_shuffle_epi8(loadTable(kTables.high), highNibbles));
+    }
+};
+
+// byte i of the result is 0xFF iff bit i of bits is set
+inline __m128i expandBits(uint32_t bits)
+{
+    __m128i bytes = _mm_shuffle_epi8(
+        _mm_set1_epi16(int16_t(bits)),
+        _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1));
+    __m128i selector = _mm_set1_epi64x(int64_t(0x8040201008040201));
+    return _mm_cmpeq_epi8(_mm_and_si128(bytes, selector), selector);
+}
+
+}  // namespace charclass
+
+// toLower() for an arbitrary word definition: bytes out of words become NULs
+template<typename CharClass>
+inline void toLower(char * beg, char * const end)
+{
+    assert(beg <= end);
+    assert((reinterpret_cast<std::uintptr_t>(beg) % sizeof(__m128i)) == 0);
+    assert((reinterpret_cast<std::uintptr_t>(end) % sizeof(__m128i)) == 0);
+    charclass::Classifier<CharClass> classify;
+    for (; beg < end; beg += sizeof(__m128i)) {
+        __m128i string = _mm_load_si128(reinterpret_cast<const __m128i *>(beg));
+        __m128i lowercase;
+        __m128i mask;
+        if constexpr (charclass::kHasInner<CharClass>) {
+            mask = charclass::expandBits(classify(string, lowercase, beg, end));
+        } else {
+            mask = classify.separatorMask(string, lowercase);
+        }
+        _mm_store_si128(reinterpret_cast<__m128i *>(beg),
+                        _mm_andnot_si128(mask, lowercase));
+    }
+}
@@ -1,7 +1,11 @@
 #pragma once
 
 #include "helpers.hpp"
+#include "memory.hpp"
+#include "options.hpp"
+#include "rank.hpp"
 #include "timer.hpp"
+#include "utf8.hpp"
 
 #include <fmt/color.h>
 #include <fmt/format.h>
@@ -20,17 +24,35 @@
 #include <cstdint>
 #include <cstdlib>
 
+inline void reportAllocations(const AllocationStats & before,
+                              std::size_t uniqueWordCount)
+{
+    auto after = AllocationStats::current();
+    std::size_t bytes = after.bytes - before.bytes;
+    std::size_t wordCount = std::max<std::size_t>(uniqueWordCount, 1);
+    fmt::print(stderr,
+               "allocated = {} bytes in {} blocks ({} allocations), {:.1f} "
+               "bytes per unique word\n",
+               bytes, after.count - before.count,
+               after.totalCount - before.totalCount,
+               double(bytes) / double(wordCount));
+}
+
 template<template<typename...> typename Map, bool kIsOrdered = false,
          bool kSetEmptyKey = false>
 int countWords(int argc, char * argv[])
 {
     Timer timer{fmt::format(fg(fmt::color::dark_green), "total")};
 
-    if (argc < 3) {
+    Options options{argc, argv};
+    const auto & positional = options.getPositional();
+    if (positional.size() < 2) {
         return EXIT_FAILURE;
     }
+    // words are runs of UTF-8 letters, case folded
+    bool utf8 = options.has("utf8");
 
-    std::ifstream i(argv[1]);
+    std::ifstream i(std::string{positional[0]});
     if (!i.is_open()) {
         return EXIT_FAILURE;
     }
@@ -45,22 +67,32 @@ int countWords(int argc, char * argv[])
 
     timer.report("read input");
 
-    auto toLowerChar = [](char c) {
-        return char(std::tolower(std::make_unsigned_t<char>(c)));
-    };
-    std::transform(std::cbegin(input), std::cend(input), std::begin(input),
-                   toLowerChar);
-
-    timer.report("make input lowercase");
+    if (utf8) {
+        if (!foldUtf8(input.data(), std::next(input.data(), input.size()))) {
+            fmt::print(stderr,
+                       "input is not valid UTF-8, invalid sequences are "
+                       "treated as separators\n");
+        }
+        timer.report("fold input case");
+    } else {
+        auto toLowerChar = [](char c) {
+            return char(std::tolower(std::make_unsigned_t<char>(c)));
+        };
+        std::transform(std::cbegin(input), std::cend(input), std::begin(input),
+                       toLowerChar);
+        timer.report("make input lowercase");
+    }
 
-    Map<std::string_view, uint32_t> wordCounts;
+    auto allocationStats = AllocationStats::current();
+    Map<std::string_view, uint64_t> wordCounts;
     if constexpr (kSetEmptyKey) {
         using namespace std::string_view_literals;
         wordCounts.set_empty_key(""sv);
     }
 
-    auto isAlpha = [](char c) {
-        return bool(std::isalpha(std::make_unsigned_t<char>(c)));
+    auto isAlpha = [utf8](char c) {
+        return utf8 ? (c != '\0')
+                    : bool(std::isalpha(std::make_unsigned_t<char>(c)));
     };
     auto end = std::next(input.data(), input.size());
     auto beg = std::find_if(input.data(), end, isAlpha);
@@ -72,32 +104,36 @@ int countWords(int argc, char * argv[])
 
     timer.report(fmt::format(fg(fmt::color::dark_blue), "count words"));
 
-    std::vector<const typename decltype(wordCounts)::value_type *> output;
+    reportAllocations(allocationStats, wordCounts.size());
+
+    using WordCount = typename decltype(wordCounts)::value_type;
+    std::vector<PrefixRankEntry<const WordCount *>> output;
     output.reserve(wordCounts.size());
     for (const auto & wordCount : wordCounts) {
-        output.push_back(&wordCount);
+        output.push_back(
+            {getWordPrefix(wordCount.first), wordCount.second, &wordCount});
     }
 
     if (kIsOrdered) {
-        auto isLess = [](auto lhs, auto rhs) -> bool {
-            return rhs->second < lhs->second;
+        auto isLess = [](const auto & lhs, const auto & rhs) -> bool {
+            return rhs.count < lhs.count;
         };
         std::stable_sort(std::begin(output), std::end(output), isLess);
     } else {
-        auto isLess = [](auto lhs, auto rhs) -> bool {
-            return std::tie(rhs->second, lhs->first) <
-                   std::tie(lhs->second, rhs->first);
+        auto wordLess = [](auto lhs, auto rhs) -> bool {
+            return lhs->first < rhs->first;
         };
-        std::sort(std::begin(output), std::end(output), isLess);
+        std::sort(std::begin(output), std::end(output),
+                  PrefixRankLess{wordLess});
     }
     timer.report(fmt::format(fg(fmt::color::dark_orange), "sort words"));
 
-    std::ofstream o(argv[2]);
+    std::ofstream o(std::string{positional[1]});
     if (!o.is_open()) {
         return EXIT_FAILURE;
     }
-    for (auto wordCount : output) {
-        o << wordCount->second << ' ' << wordCount->first << '\n';
+    for (const auto & [prefix, count, wordCount] : output) {
+        o << count << ' ' << wordCount->first << '\n';
     }
     timer.report("write output");
 
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+
+// xoshiro256** seeded by splitmix64: unlike std distributions its output does
+// not depend on the standard library implementation
+class Random
+{
+public:
+    explicit Random(uint64_t seed)
+    {
+        for (uint64_t & s : state) {
+            seed += 0x9E3779B97F4A7C15u;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9u;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBu;
+            s = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t operator()()
+    {
+        uint64_t result = rotl(state[1] * 5, 7) * 9;
+        uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
+    }
+
+    // [0, 1)
+    double uniform()
+    {
+        return double((*this)() >> 11) * 0x1.0p-53;
+    }
+
+    // [0, n)
+    uint64_t below(uint64_t n)
+    {
+        return uint64_t((unsigned __int128)((*this)()) * n >> 64);
+    }
+
+    bool bernoulli(double p)
+    {
+        return uniform() < p;
+    }
+
+private:
+    uint64_t state[4];
+
+    static uint64_t rotl(uint64_t x, int k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+};
+
+// rejection-inversion sampling of Zipf distribution over ranks [1, n] with
+// P(k) ~ k^-exponent (Hormann, Derflinger), O(1) memory for any n
+class ZipfDistribution
+{
+public:
+    ZipfDistribution(uint64_t n, double exponent) : n{n}, exponent{exponent}
+    {
+        assert(n > 0);
+        assert(exponent >= 0.0);
+        hIntegralX1 = hIntegral(1.5) - 1.0;
+        hIntegralN = hIntegral(double(n) + 0.5);
+        s = 2.0 - hIntegralInverse(hIntegral(2.5) - h(2.0));
+    }
+
+    // 1-based rank
+    uint64_t operator()(Random & random) const
+    {
+        for (;;) {
+            double u =
+                hIntegralN + random.uniform() * (hIntegralX1 - hIntegralN);
+            double x = hIntegralInverse(u);
+            auto k = uint64_t(std::clamp(x + 0.5, 1.0, double(n)));
+            if (double(k) - x <= s ||
+                u >= hIntegral(double(k) + 0.5) - h(double(k)))
+            {
+                return k;
+            }
+        }
+    }
+
+private:
+    const uint64_t n;
+    const double exponent;
+    double hIntegralX1;
+    double hIntegralN;
+    double s;
+
+    double h(double x) const
+    {
+        return std::exp(-exponent * std::log(x));
+    }
+
+    double hIntegral(double x) const
+    {
+        double logX = std::log(x);
+        return helper2((1.0 - exponent) * logX) * logX;
+    }
+
+    double hIntegralInverse(double x) const
+    {
+        double t = std::max(x * (1.0 - exponent), -1.0);
+        return std::exp(helper1(t) * x);
+    }
+
+    // log1p(x) / x
+    static double helper1(double x)
+    {
+        if (std::abs(x) > 1E-8) {
+            return std::log1p(x) / x;
+        }
+        return 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+
+    // expm1(x) / x
+    static double helper2(double x)
+    {
+        if (std::abs(x) > 1E-8) {
+            return std::expm1(x) / x;
+        }
+        return 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+    }
+};
+
+struct CorpusParameters
+{
+    uint64_t size = uint64_t(1) << 20;  // bytes
+    uint64_t vocabularySize = 100000;
+    double zipfExponent = 1.0;
+    uint32_t minWordLength = 1;
+    uint32_t maxWordLength = 20;
+    double meanWordLength = 7.0;  // of truncated geometric distribution
+    double capitalizedProbability = 0.0;  // "Word"
+    double uppercaseProbability = 0.0;    // "WORD"
+    double punctuationProbability = 0.0;  // separator other than ' '
+    uint64_t seed = 0;
+};
+
+// unique lowercase words, vocabulary[rank - 1] has the rank in Zipf
+// distribution
+class Vocabulary
+{
+public:
+    Vocabulary(const CorpusParameters & parameters, Random & random)
+        : words{0, WordHash{letters}, WordEqual{letters}}
+    {
+        assert(parameters.minWordLength > 0);
+        assert(parameters.minWordLength <= parameters.maxWordLength);
+        double p = 1.0 / std::max(1.0, parameters.meanWordLength -
+                                           parameters.minWordLength + 1.0);
+        words.reserve(parameters.vocabularySize);
+        offsets.reserve(parameters.vocabularySize + 1);
+        offsets.push_back(0);
+        uint64_t attempts = 0;
+        while (words.size() < parameters.vocabularySize) {
+            if (++attempts > 16 * parameters.vocabularySize + 1000) {
+                break;  // vocabulary does not fit into length limits
+            }
+            uint32_t length;
+            do {
+                length = parameters.minWordLength;
+                if (p < 1.0) {
+                    length += uint32_t(std::log1p(-random.uniform()) /
+                                       std::log1p(-p));
+                }
+            } while (length > parameters.maxWordLength);
+            for (uint32_t i = 0; i < length; ++i) {
+                letters.push_back(char('a' + random.below('z' - 'a' + 1)));
+            }
+            letters.push_back('\0');
+            if (words.insert(offsets.back()).second) {
+                offsets.push_back(letters.size());
+            } else {
+                letters.resize(offsets.back());
+            }
+        }
+    }
+
+    Vocabulary(const Vocabulary &) = delete;
+    Vocabulary & operator=(const Vocabulary &) = delete;
+
+    std::size_t size() const
+    {
+        return offsets.size() - 1;
+    }
+
+    std::string_view operator[](std::size_t index) const
+    {
+        return {std::next(letters.data(), offsets[index]),
+                offsets[index + 1] - offsets[index] - 1};
+    }
+
+    // NUL-terminated
+    const char * c_str(std::size_t index) const
+    {
+        return std::next(letters.data(), offsets[index]);
+    }
+
+private:
+    struct WordHash
+    {
+        const std::vector<char> & letters;
+
+        std::size_t operator()(uint64_t offset) const
+        {
+            return std::hash<std::string_view>{}(
+                std::next(letters.data(), offset));
+        }
+    };
+
+    struct WordEqual
+    {
+        const std::vector<char> & letters;
+
+        bool operator()(uint64_t lhs, uint64_t rhs) const
+        {
+            return std::string_view{std::next(letters.data(), lhs)} ==
+                   std::string_view{std::next(letters.data(), rhs)};
+        }
+    };
+
+    std::vector<char> letters;
+    std::vector<uint64_t> offsets;
+    std::unordered_set<uint64_t, WordHash, WordEqual> words;
+};
+
+// Calls onWord(index) for every word and onText(text) for every piece of text
+// until parameters.size bytes are produced
+template<typename OnWord, typename OnText>
+void generateCorpus(const CorpusParameters & parameters,
+                    const Vocabulary & vocabulary, Random & random,
+                    OnWord && onWord, OnText && onText)
+{
+    static constexpr std::string_view kPunctuation =
+        " \n\t.,;:!?-()\"'0123456789";
+    ZipfDistribution zipf{vocabulary.size(), parameters.zipfExponent};
+    std::string text;
+    uint64_t size = 0;
+    while (size < parameters.size) {
+        auto index = zipf(random) - 1;
+        onWord(index);
+        text = vocabulary[index];
+        if (random.bernoulli(parameters.capitalizedProbability)) {
+            text.front() = char(text.front() - 'a' + 'A');
+        } else if (random.bernoulli(parameters.uppercaseProbability)) {
+            for (char & c : text) {
+                c = char(c - 'a' + 'A');
+            }
+        }
+        if (random.bernoulli(parameters.punctuationProbability)) {
+            for (auto n = 1 + random.below(3); n != 0; --n) {
+                text.push_back(kPunctuation[random.below(kPunctuation.size())]);
+            }
+        } else {
+            text.push_back(' ');
+        }
+        onText(std::string_view{text});
+        size += text.size();
+    }
+}
@@ -0,0 +1,338 @@
+#pragma once
+
+#include "io.hpp"
+
+#include <fmt/format.h>
+#if defined(FREQ_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(FREQ_HAVE_ZSTD)
+#include <zstd.h>
+#endif
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+// Compressed input is detected by magic bytes and decompressed by a Source,
+// so that decompressed blocks go straight to AsyncReader
+enum class Compression
+{
+    kNone,
+    kGzip,
+    kZstd,
+};
+
+inline std::string_view getCompressionName(Compression compression)
+{
+    switch (compression) {
+    case Compression::kNone:
+        return "none";
+    case Compression::kGzip:
+        return "gzip";
+    case Compression::kZstd:
+        return "zstd";
+    }
+    return {};
+}
+
+#if defined(FREQ_HAVE_ZLIB)
+// gzip (also multi-member) or zlib stream
+class GzipDecompressor
+{
+public:
+    GzipDecompressor(std::FILE * inputFile, std::string_view prefix)
+        : inputFile{inputFile}
+    {
+        // 32: detect gzip or zlib header
+        success = (inflateInit2(&stream, 15 + 32) == Z_OK);
+        std::copy(std::cbegin(prefix), std::cend(prefix), input);
+        stream.next_in = reinterpret_cast<Bytef *>(input);
+        stream.avail_in = uInt(prefix.size());
+    }
+
+    GzipDecompressor(const GzipDecompressor &) = delete;
+    GzipDecompressor & operator=(const GzipDecompressor &) = delete;
+
+    ~GzipDecompressor()
+    {
+        inflateEnd(&stream);
+    }
+
+    std::ptrdiff_t operator()(char * buffer, std::size_t size)
+    {
+        if (!success) {
+            return -1;
+        }
+        stream.next_out = reinterpret_cast<Bytef *>(buffer);
+        stream.avail_out = uInt(size);
+        while (stream.avail_out != 0) {
+            if ((stream.avail_in == 0) && !refill()) {
+                if (!success) {
+                    return -1;
+                }
+                if (!memberFinished) {
+                    fmt::print(stderr, "gzip input is truncated\n");
+                    return -1;
+                }
+                break;
+            }
+            if (std::exchange(memberFinished, false) &&
+                (inflateReset(&stream) != Z_OK))
+            {
+                return -1;
+            }
+            int status = inflate(&stream, Z_NO_FLUSH);
+            if (status == Z_STREAM_END) {
+                memberFinished = true;
+            } else if ((status != Z_OK) && (status != Z_BUF_ERROR)) {
+                fmt::print(stderr, "gzip input is corrupted: {}\n",
+                           stream.msg ? stream.msg : "unknown error");
+                success = false;
+                return -1;
+            }
+        }
+        return std::ptrdiff_t(size - stream.avail_out);
+    }
+
+private:
+    std::FILE * const inputFile;
+    z_stream stream = {};
+    bool success = true;
+    bool memberFinished = false;
+    char input[1 << 17];
+
+    bool refill()
+    {
+        std::size_t readSize = std::fread(input, 1, sizeof input, inputFile);
+        if (std::ferror(inputFile) != 0) {
+            success = false;
+        }
+        stream.next_in = reinterpret_cast<Bytef *>(input);
+        stream.avail_in = uInt(readSize);
+        return readSize != 0;
+    }
+};
+#endif
+
+#if defined(FREQ_HAVE_ZSTD)
+// Frames of a multi-frame zstd input (e.g. zstd -T0 --rsyncable or pzstd)
+// are decompressed in parallel, a batch of one frame per thread at a time.
+// The compressed input is read in memory as a whole.
+class ZstdDecompressor
+{
+public:
+    ZstdDecompressor(std::FILE * inputFile, std::string_view prefix)
+        : compressed{std::cbegin(prefix), std::cend(prefix)}
+    {
+        char buffer[1 << 16];
+        for (;;) {
+            std::size_t readSize =
+                std::fread(buffer, 1, sizeof buffer, inputFile);
+            compressed.insert(std::cend(compressed), buffer,
+                              std::next(buffer, std::ptrdiff_t(readSize)));
+            if (readSize != sizeof buffer) {
+                break;
+            }
+        }
+        success = (std::ferror(inputFile) == 0);
+        std::size_t threadCount = 1;
+#if defined(_OPENMP)
+        threadCount = std::size_t(omp_get_max_threads());
+#endif
+        frames.resize(threadCount);
+        for (auto & frame : frames) {
+            frame.context.reset(ZSTD_createDCtx());
+        }
+    }
+
+    ZstdDecompressor(const ZstdDecompressor &) = delete;
+    ZstdDecompressor & operator=(const ZstdDecompressor &) = delete;
+
+    std::ptrdiff_t operator()(char * buffer, std::size_t size)
+    {
+        std::size_t readSize = 0;
+        while (success && (readSize < size)) {
+            if (frameIndex == frameCount) {
+                if (position == compressed.size()) {
+                    break;
+                }
+                decompressBatch();
+                continue;
+            }
+            const auto & output = frames[frameIndex].output;
+            std::size_t chunk =
+                std::min(output.size() - outputPosition, size - readSize);
+            std::copy_n(std::next(output.data(),
+                                  std::ptrdiff_t(outputPosition)),
+                        chunk, std::next(buffer, std::ptrdiff_t(readSize)));
+            readSize += chunk;
+            outputPosition += chunk;
+            if (outputPosition == output.size()) {
+                ++frameIndex;
+                outputPosition = 0;
+            }
+        }
+        return success ? std::ptrdiff_t(readSize) : -1;
+    }
+
+private:
+    struct ContextDeleter
+    {
+        void operator()(ZSTD_DCtx * context) const
+        {
+            ZSTD_freeDCtx(context);
+        }
+    };
+
+    struct Frame
+    {
+        std::unique_ptr<ZSTD_DCtx, ContextDeleter> context;
+        std::size_t begin = 0;
+        std::size_t size = 0;
+        std::vector<char> output;
+        bool success = true;
+    };
+
+    std::vector<char> compressed;
+    std::size_t position = 0;
+    std::vector<Frame> frames;
+    std::size_t frameCount = 0;
+    std::size_t frameIndex = 0;
+    std::size_t outputPosition = 0;
+    bool success = true;
+
+    void decompressBatch()
+    {
+        frameCount = 0;
+        frameIndex = 0;
+        while ((frameCount < frames.size()) &&
+               (position < compressed.size()))
+        {
+            std::size_t frameSize = ZSTD_findFrameCompressedSize(
+                std::next(compressed.data(), std::ptrdiff_t(position)),
+                compressed.size() - position);
+            if (ZSTD_isError(frameSize)) {
+                fmt::print(stderr, "zstd input is corrupted: {}\n",
+                           ZSTD_getErrorName(frameSize));
+                success = false;
+                return;
+            }
+            frames[frameCount].begin = position;
+            frames[frameCount].size = frameSize;
+            position += frameSize;
+            ++frameCount;
+        }
+#pragma omp parallel for schedule(dynamic, 1) num_threads(int(frameCount))
+        for (int64_t i = 0; i < int64_t(frameCount); ++i) {
+            decompressFrame(frames[std::size_t(i)]);
+        }
+        for (std::size_t i = 0; i < frameCount; ++i) {
+            success = success && frames[i].success;
+        }
+    }
+
+    void decompressFrame(Frame & frame)
+    {
+        const char * src =
+            std::next(compressed.data(), std::ptrdiff_t(frame.begin));
+        frame.output.clear();
+        frame.success = true;
+        auto contentSize = ZSTD_getFrameContentSize(src, frame.size);
+        if ((contentSize != ZSTD_CONTENTSIZE_UNKNOWN) &&
+            (contentSize != ZSTD_CONTENTSIZE_ERROR))
+        {
+            frame.output.resize(std::size_t(contentSize));
+            std::size_t size = ZSTD_decompressDCtx(
+                frame.context.get(), frame.output.data(), frame.output.size(),
+                src, frame.size);
+            frame.success = !ZSTD_isError(size) && (size == contentSize);
+            return;
+        }
+        // content size is not stored in streamed frames
+        ZSTD_DCtx_reset(frame.context.get(), ZSTD_reset_session_only);
+        ZSTD_inBuffer in = {src, frame.size, 0};
+        while (frame.success && (in.pos < in.size)) {
+            std::size_t outputSize = frame.output.size();
+            frame.output.resize(outputSize + ZSTD_DStreamOutSize());
+            ZSTD_outBuffer out = {std::next(frame.output.data(),
+                                            std::ptrdiff_t(outputSize)),
+                                  ZSTD_DStreamOutSize(), 0};
+            std::size_t status =
+                ZSTD_decompressStream(frame.context.get(), &out, &in);
+            frame.success = !ZSTD_isError(status);
+            frame.output.resize(outputSize + out.pos);
+        }
+    }
+};
+#endif
+
+// Detects compression of inputFile by magic bytes; prefix is the bytes read
+inline Compression detectCompression(std::FILE * inputFile,
+                                     std::string & prefix)
+{
+    char magic[4];
+    std::size_t readSize = std::fread(magic, 1, sizeof magic, inputFile);
+    prefix.assign(magic, readSize);
+    if ((readSize >= 2) && (uint8_t(magic[0]) == 0x1F) &&
+        (uint8_t(magic[1]) == 0x8B))
+    {
+        return Compression::kGzip;
+    }
+    constexpr char kZstdMagic[4] = {'\x28', '\xB5', '\x2F', '\xFD'};
+    if ((readSize == sizeof magic) &&
+        (std::memcmp(magic, kZstdMagic, sizeof magic) == 0))
+    {
+        return Compression::kZstd;
+    }
+    return Compression::kNone;
+}
+
+// Source of decompressed contents of inputFile, an empty function for an
+// unsupported compression
+inline Source openSource(const File & inputFile, Compression & compression)
+{
+    std::string prefix;
+    compression = detectCompression(inputFile.get(), prefix);
+    switch (compression) {
+    case Compression::kNone:
+        return makeFileSource(inputFile, std::move(prefix));
+    case Compression::kGzip: {
+#if defined(FREQ_HAVE_ZLIB)
+        auto decompressor =
+            std::make_shared<GzipDecompressor>(inputFile.get(), prefix);
+        return [decompressor](char * buffer, std::size_t size) {
+            return (*decompressor)(buffer, size);
+        };
+#else
+        fmt::print(stderr, "gzip support is disabled at build time\n");
+        return {};
+#endif
+    }
+    case Compression::kZstd: {
+#if defined(FREQ_HAVE_ZSTD)
+        auto decompressor =
+            std::make_shared<ZstdDecompressor>(inputFile.get(), prefix);
+        return [decompressor](char * buffer, std::size_t size) {
+            return (*decompressor)(buffer, size);
+        };
+#else
+        fmt::print(stderr, "zstd support is disabled at build time\n");
+        return {};
+#endif
+    }
+    }
+    return {};
+}
@@ -0,0 +1,253 @@
+#include "charclass.hpp"
+#include "helpers.hpp"
+#include "io.hpp"
+#include "memory.hpp"
+#include "mphf.hpp"
+#include "options.hpp"
+#include "rank.hpp"
+#include "snapshot.hpp"
+#include "tag_map.hpp"
+#include "timer.hpp"
+#include "tokenizer.hpp"
+
+#include <fmt/color.h>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+
+SnapshotHeader makeDictionaryHeader()
+{
+    return makeSnapshotHeader("mphf", "alpha", mphf::kInitialChecksum,
+                              /* tableOrder */ 0, /* flags */ 0,
+                              /* elementSize */ 1);
+}
+
+// words of vocabulary.txt, any text including output of the counters, split
+// and made lowercase like input is
+int buildDictionary(const std::string & vocabularyPath,
+                    const std::string & dictionaryPath, Timer & timer)
+{
+    InputBuffer inputBuffer;
+    if (!inputBuffer.read(vocabularyPath)) {
+        fmt::print(stderr, "failed to read '{}' file\n", vocabularyPath);
+        return EXIT_FAILURE;
+    }
+    toLower<charclass::Alpha>(inputBuffer.begin(), inputBuffer.end());
+    std::vector<std::string_view> vocabulary;
+    uint32_t hash = mphf::kInitialChecksum;
+    uint32_t len = 0;
+    auto onWord = [&vocabulary](uint32_t, const char * wordEnd, uint32_t len) {
+        vocabulary.emplace_back(std::prev(wordEnd, len), len);
+    };
+    // NUL padding ends the last word
+    tokenize</* kInputIsLowercase */ true>(inputBuffer.begin(),
+                                           inputBuffer.end(),
+                                           mphf::kInitialChecksum, hash, len,
+                                           onWord);
+    std::sort(std::begin(vocabulary), std::end(vocabulary));
+    vocabulary.erase(std::unique(std::begin(vocabulary), std::end(vocabulary)),
+                     std::end(vocabulary));
+    if (vocabulary.empty()) {
+        fmt::print(stderr, "vocabulary is empty\n");
+        return EXIT_FAILURE;
+    }
+    timer.report("read vocabulary");
+
+    std::vector<char> dictionary;
+    std::vector<std::string_view> collisions;
+    if (!mphf::build(vocabulary, dictionary, collisions)) {
+        fmt::print(stderr, "failed to build minimal perfect hash\n");
+        return EXIT_FAILURE;
+    }
+    mphf::Dictionary view{dictionary.data()};
+    // pilots and remap, the rest is to verify words
+    std::size_t functionSize = mphf::Sections{view.getLayout()}.keys;
+    fmt::print(stderr,
+               "{} words, {} bytes, hash function {} bytes ({:.1f} bits per "
+               "word)\n",
+               view.size(), dictionary.size(), functionSize,
+               double(functionSize) * 8 / double(view.size()));
+    if (!collisions.empty()) {
+        fmt::print(stderr,
+                   "{} words share hashes with other words, they are counted "
+                   "out of vocabulary\n",
+                   collisions.size());
+    }
+    timer.report(fmt::format(fg(fmt::color::dark_orange), "build dictionary"));
+
+    if (!writeSnapshot(dictionaryPath, makeDictionaryHeader(), dictionary)) {
+        return EXIT_FAILURE;
+    }
+    timer.report("write dictionary");
+    return EXIT_SUCCESS;
+}
+
+// the data of a dictionary file mapped read-only, null on failure
+MappedPtr<char> mapDictionary(const std::string & path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        fmt::print(stderr, "failed to open dictionary '{}'\n", path);
+        return {nullptr, MappedDeleter{0}};
+    }
+    struct stat st = {};
+    if ((fstat(fd, &st) != 0) ||
+        (std::size_t(st.st_size) < kSnapshotHeaderSize + sizeof(mphf::Layout)))
+    {
+        fmt::print(stderr, "dictionary '{}' is too short\n", path);
+        close(fd);
+        return {nullptr, MappedDeleter{0}};
+    }
+    auto size = std::size_t(st.st_size);
+    void * p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        fmt::print(stderr, "failed to map dictionary '{}'\n", path);
+        return {nullptr, MappedDeleter{0}};
+    }
+    MappedPtr<char> data{static_cast<char *>(p), MappedDeleter{size}};
+    const auto & header = *reinterpret_cast<const SnapshotHeader *>(p);
+    if (!checkSnapshotHeader(header, makeDictionaryHeader(), path)) {
+        return {nullptr, MappedDeleter{0}};
+    }
+    const char * dictionary = std::next(data.get(), kSnapshotHeaderSize);
+    mphf::Layout layout;
+    std::memcpy(&layout, dictionary, sizeof layout);
+    if ((header.elementCount != mphf::Sections{layout}.size) ||
+        (size < kSnapshotHeaderSize + header.elementCount))
+    {
+        fmt::print(stderr, "dictionary '{}' is incompatible: size mismatch\n",
+                   path);
+        return {nullptr, MappedDeleter{0}};
+    }
+    return data;
+}
+
+}  // namespace
+
+// Counting by a minimal perfect hash dictionary of a known vocabulary:
+// --build makes the dictionary, then words of the vocabulary are counted into
+// a dense array by their positions, other words into a fallback table
+int main(int argc, char * argv[])
+{
+    Timer timer{fmt::format(fg(fmt::color::dark_green), "total")};
+
+    Options options{argc, argv};
+    const auto & positional = options.getPositional();
+    bool build = options.has("build");
+    std::string dictionaryPath{options.get("dictionary")};
+    if ((positional.size() != 2) || (!build && dictionaryPath.empty())) {
+        fmt::print(stderr,
+                   "usage: {0} --build vocabulary.txt dictionary.mphf\n"
+                   "       {0} --dictionary=dictionary.mphf in.txt out.txt\n",
+                   argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (build) {
+        return buildDictionary(std::string{positional[0]},
+                               std::string{positional[1]}, timer);
+    }
+
+    auto data = mapDictionary(dictionaryPath);
+    if (!data) {
+        return EXIT_FAILURE;
+    }
+    mphf::Dictionary dictionary{std::next(data.get(), kSnapshotHeaderSize)};
+    timer.report("map dictionary");
+
+    using namespace std::string_view_literals;
+
+    auto inputFile = (positional[0] == "-"sv)
+                         ? wrapFile(stdin)
+                         : openFile(positional[0].data(), "rb");
+    if (!inputFile) {
+        fmt::print(stderr, "failed to open '{}' file to read\n",
+                   positional[0]);
+        return EXIT_FAILURE;
+    }
+
+    auto outputFile = (positional[1] == "-"sv)
+                          ? wrapFile(stdout)
+                          : openFile(positional[1].data(), "wb");
+    if (!outputFile) {
+        fmt::print(stderr, "failed to open '{}' file to write\n",
+                   positional[1]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<uint64_t> counts(dictionary.size(), 0);
+    TagMap<std::string_view, uint64_t> fallback;
+    {
+        AsyncReader reader{inputFile};
+        uint32_t hash = mphf::kInitialChecksum;
+        uint32_t len = 0;
+        auto onWord = [&](uint32_t hash, const char * wordEnd, uint32_t len) {
+            uint64_t position = dictionary.find(hash, wordEnd, len);
+            if LIKELY (position != dictionary.size()) {
+                ++counts[position];
+            } else {
+                ++fallback[{std::prev(wordEnd, len), len}];
+            }
+        };
+        while (reader.next(len)) {
+            toLower<charclass::Alpha>(reader.begin(), reader.end());
+            tokenize</* kInputIsLowercase */ true>(
+                reader.begin(), reader.end(), mphf::kInitialChecksum, hash,
+                len, onWord);
+        }
+        if (reader.isFailed()) {
+            return EXIT_FAILURE;
+        }
+        fmt::print(stderr, "input size = {} bytes\n", reader.getReadSize());
+    }
+    timer.report(fmt::format(fg(fmt::color::dark_blue), "count words"));
+
+    std::vector<std::pair<uint64_t, std::string_view>> rank;
+    uint64_t fallbackCount = 0;
+    for (uint64_t position = 0; position < dictionary.size(); ++position) {
+        if (counts[position] != 0) {
+            rank.emplace_back(counts[position], dictionary.getWord(position));
+        }
+    }
+    for (const auto & [word, count] : fallback) {
+        rank.emplace_back(count, word);
+        fallbackCount += count;
+    }
+    fmt::print(stderr, "{} words out of vocabulary, {} occurrences\n",
+               fallback.size(), fallbackCount);
+    timer.report("collect word counts");
+
+    std::sort(std::begin(rank), std::end(rank), RankLess{});
+    timer.report(fmt::format(fg(fmt::color::dark_orange), "sort words"));
+
+    OutputStream<> outputStream{outputFile};
+    for (const auto & [count, word] : rank) {
+        if (!outputStream.print(count) || !outputStream.putChar(' ') ||
+            !outputStream.print(word) || !outputStream.putChar('\n'))
+        {
+            fmt::print(stderr, "output failure\n");
+            return EXIT_FAILURE;
+        }
+    }
+    timer.report("write output");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,302 @@
+#include "freq.hpp"
+
+#include "charclass.hpp"
+#include "helpers.hpp"
+#include "memory.hpp"
+#include "oaph.hpp"
+#include "rank.hpp"
+#include "sparsest.hpp"
+#include "trie.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <cstdint>
+
+namespace freq
+{
+
+namespace
+{
+
+// Engines count consecutive blocks: countWords() returns the number of bytes
+// of the word which is not finished at the end of a block, they should precede
+// the next block
+
+class OaphCounter
+{
+public:
+    // perfect hash seeds do not cover arbitrary input
+    using HashTable = oaph::HashTable</* kEnableOpenAddressing */ true>;
+
+    OaphCounter() : hashTable{mapZeroed<HashTable>()}
+    {
+        hashTable->init();
+    }
+
+    OaphCounter(OaphCounter &&) = default;
+
+    ~OaphCounter()
+    {
+        if (hashTable) {
+            hashTable->arena.release();
+        }
+    }
+
+    uint32_t countWords(char * beg, char * end)
+    {
+        toLower<charclass::Alpha>(beg, end);
+        hashTable->countWords(beg, end, hash, len);
+        return len;
+    }
+
+    bool isFull() const
+    {
+        return hashTable->arena.isFull();
+    }
+
+    bool rank(std::vector<WordCount> & rank) const
+    {
+        const auto & arena = hashTable->arena;
+        std::vector<PrefixRankEntry<uint32_t>> prefixRank;
+        hashTable->forEachWord([&](uint64_t count, uint32_t word) {
+            prefixRank.push_back(
+                {getWordPrefix(arena.getWord(word)), count, word});
+        });
+        auto wordLess = [&arena](uint32_t lhs, uint32_t rhs) {
+            return arena.getWord(lhs) < arena.getWord(rhs);
+        };
+        std::sort(std::begin(prefixRank), std::end(prefixRank),
+                  PrefixRankLess{wordLess});
+        rank.reserve(prefixRank.size());
+        for (const auto & [prefix, count, word] : prefixRank) {
+            rank.push_back({count, arena.getWord(word)});
+        }
+        return true;
+    }
+
+private:
+    MappedPtr<HashTable> hashTable;
+    uint32_t hash = oaph::kInitialChecksum;
+    uint32_t len = 0;
+};
+
+// 24 GiB of address space, only touched pages are backed by memory
+class SparsestCounter
+{
+public:
+    SparsestCounter() : hashTable{mapZeroed<sparsest::HashTable>()}
+    {
+        hashTable->init();
+    }
+
+    SparsestCounter(SparsestCounter &&) = default;
+
+    ~SparsestCounter()
+    {
+        if (hashTable) {
+            hashTable->arena.release();
+        }
+    }
+
+    uint32_t countWords(char * beg, char * end)
+    {
+        hashTable->countWords(beg, end, hash, len);
+        return len;
+    }
+
+    bool isFull() const
+    {
+        return hashTable->arena.isFull() || hashTable->spillTable.full;
+    }
+
+    // words are stored as they occur first
+    bool rank(std::vector<WordCount> & rank) const
+    {
+        auto & arena = hashTable->arena;
+        arena.toLower<charclass::Alpha>();
+        std::vector<PrefixRankEntry<uint32_t>> prefixRank;
+        bool success =
+            hashTable->forEachWord([&](uint64_t count, uint32_t word) {
+                prefixRank.push_back(
+                    {getWordPrefix(arena.getWord(word)), count, word});
+            });
+        if (!success) {
+            return false;
+        }
+        auto wordLess = [&arena](uint32_t lhs, uint32_t rhs) {
+            return arena.getWord(lhs) < arena.getWord(rhs);
+        };
+        std::sort(std::begin(prefixRank), std::end(prefixRank),
+                  PrefixRankLess{wordLess});
+        rank.reserve(prefixRank.size());
+        for (const auto & [prefix, count, word] : prefixRank) {
+            rank.push_back({count, arena.getWord(word)});
+        }
+        return true;
+    }
+
+private:
+    MappedPtr<sparsest::HashTable> hashTable;
+    uint32_t hash = sparsest::kInitialChecksum;
+    uint32_t len = 0;
+};
+
+class TrieCounter
+{
+public:
+    // the node of an unfinished word is carried over instead of its bytes
+    uint32_t countWords(char * beg, char * end)
+    {
+        toLower(beg, end);
+        trie::countWords(trie, index, beg, end);
+        return 0;
+    }
+
+    bool isFull() const
+    {
+        return false;
+    }
+
+    bool rank(std::vector<WordCount> & rank)
+    {
+        trie::finish(trie, index);
+        std::vector<std::pair<uint32_t, uint32_t>> offsetRank;
+        words.clear();
+        trie::recoverWords(trie, offsetRank, words);
+        // traversal yields words in ascending order already
+        std::stable_sort(std::begin(offsetRank), std::end(offsetRank),
+                         RankCountLess{});
+        rank.reserve(offsetRank.size());
+        for (const auto & [count, word] : offsetRank) {
+            rank.push_back({count, std::next(words.data(), word)});
+        }
+        return true;
+    }
+
+private:
+    std::vector<trie::TrieNode> trie = std::vector<trie::TrieNode>(1);
+    uint32_t index = 0;
+    std::vector<char> words;  // NUL-terminated words of the last rank()
+};
+
+}  // namespace
+
+// Text is gathered into blocks like the ones of AsyncReader: aligned, with
+// room for the unfinished word of the previous block in front
+struct Context::Impl
+{
+    static constexpr std::size_t kBlockSize = 1 << 20;
+    static constexpr std::size_t kMaxCarry = 1 << 16;
+
+    std::variant<OaphCounter, SparsestCounter, TrieCounter> counter;
+    AlignedBuffer storage = makeAlignedBuffer(kMaxCarry + kBlockSize);
+    std::size_t size = 0;  // bytes of the current block
+    bool failed = false;
+    std::vector<WordCount> rank;
+
+    explicit Impl(Engine engine) : counter{makeCounter(engine)} {}
+
+    static decltype(counter) makeCounter(Engine engine)
+    {
+        switch (engine) {
+        case Engine::kOaph:
+            break;
+        case Engine::kSparsest:
+            return SparsestCounter{};
+        case Engine::kTrie:
+            return TrieCounter{};
+        }
+        return OaphCounter{};
+    }
+
+    char * begin() const
+    {
+        return std::next(storage.get(), kMaxCarry);
+    }
+
+    // size should be a multiple of sizeof(__m128i)
+    void countBlock()
+    {
+        char * end = std::next(begin(), std::ptrdiff_t(size));
+        std::size_t carry = std::visit(
+            [this, end](auto & counter) -> std::size_t {
+                return counter.countWords(begin(), end);
+            },
+            counter);
+        size = 0;
+        if (carry > kMaxCarry) {
+            failed = true;
+            return;
+        }
+        std::copy_n(std::prev(end, std::ptrdiff_t(carry)), carry,
+                    std::prev(begin(), std::ptrdiff_t(carry)));
+        failed = std::visit(
+            [](const auto & counter) { return counter.isFull(); }, counter);
+    }
+};
+
+Context::Context(Engine engine) : impl{std::make_unique<Impl>(engine)} {}
+
+Context::Context(Context &&) noexcept = default;
+
+Context & Context::operator=(Context &&) noexcept = default;
+
+Context::~Context() = default;
+
+bool Context::feed(std::span<const char> text)
+{
+    while (!impl->failed && !text.empty()) {
+        auto size = std::min(text.size(), Impl::kBlockSize - impl->size);
+        std::copy_n(std::cbegin(text), size,
+                    std::next(impl->begin(), std::ptrdiff_t(impl->size)));
+        impl->size += size;
+        text = text.subspan(size);
+        if (impl->size == Impl::kBlockSize) {
+            impl->countBlock();
+        }
+    }
+    return !impl->failed;
+}
+
+std::span<const WordCount> Context::finish()
+{
+    impl->rank.clear();
+    if (impl->failed) {
+        return {};
+    }
+    // NUL padding ends the last word, a full block is counted by feed()
+    auto paddedSize =
+        (impl->size + sizeof(__m128i)) / sizeof(__m128i) * sizeof(__m128i);
+    std::fill(std::next(impl->begin(), std::ptrdiff_t(impl->size)),
+              std::next(impl->begin(), std::ptrdiff_t(paddedSize)), '\0');
+    impl->size = paddedSize;
+    impl->countBlock();
+    if (impl->failed) {
+        return {};
+    }
+    impl->failed = !std::visit(
+        [this](auto & counter) { return counter.rank(impl->rank); },
+        impl->counter);
+    return impl->rank;
+}
+
+bool Context::finish(const Sink & sink)
+{
+    for (const auto & [count, word] : finish()) {
+        if (!sink(count, word)) {
+            return false;
+        }
+    }
+    return !impl->failed;
+}
+
+bool Context::isFailed() const
+{
+    return impl->failed;
+}
+
+}  // namespace freq
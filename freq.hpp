@@ -0,0 +1,61 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <span>
+#include <string_view>
+
+#include <cstdint>
+
+// Embeddable word counting: a Context counts words of text fed to it in pieces
+// of any size and ranks them like the binaries do, contexts are independent
+namespace freq
+{
+
+enum class Engine
+{
+    kOaph,      // open addressing hash table of verified words
+    kSparsest,  // counters addressed by CRC32 directly, no key comparison
+    kTrie,
+};
+
+struct WordCount
+{
+    uint64_t count;
+    std::string_view word;  // lowercase
+};
+
+// returns false to stop
+using Sink = std::function<bool(uint64_t count, std::string_view word)>;
+
+class Context
+{
+public:
+    explicit Context(Engine engine = Engine::kOaph);
+    Context(Context &&) noexcept;
+    Context & operator=(Context &&) noexcept;
+    ~Context();
+
+    // counts words of text, a word may continue in the next feed(); false if
+    // the context is failed
+    bool feed(std::span<const char> text);
+
+    // ends the last word, then ranks words by descending count, then by
+    // ascending word; the view is valid until the next call of the context;
+    // counting may be continued by feed()
+    std::span<const WordCount> finish();
+
+    // finish() into sink, false if the context is failed or sink stopped
+    bool finish(const Sink & sink);
+
+    // a word crossing a boundary of 1 MiB blocks was longer than 64 KiB or a
+    // word did not fit into the engine; the context should be replaced
+    bool isFailed() const;
+
+private:
+    struct Impl;
+
+    std::unique_ptr<Impl> impl;
+};
+
+}  // namespace freq
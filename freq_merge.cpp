@@ -0,0 +1,171 @@
+#include "io.hpp"
+#include "options.hpp"
+#include "partial.hpp"
+#include "rank.hpp"
+#include "timer.hpp"
+
+#include <fmt/color.h>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+// k-way merge of partial results: only the current record of every input is
+// kept in memory, the "count word" output additionally needs all the merged
+// words to sort them by count
+int main(int argc, char * argv[])
+{
+    Timer timer{fmt::format(fg(fmt::color::dark_green), "total")};
+
+    Options options{argc, argv};
+    const auto & positional = options.getPositional();
+    if (positional.size() < 2) {
+        fmt::print(stderr,
+                   "usage: {} [--partial] in.partial... out.txt|out.partial\n",
+                   argv[0]);
+        return EXIT_FAILURE;
+    }
+    bool partialOutput = options.has("partial");
+
+    using namespace std::string_view_literals;
+
+    std::vector<std::unique_ptr<PartialReader>> readers;
+    for (auto path : std::vector<std::string_view>{
+             std::cbegin(positional), std::prev(std::cend(positional))})
+    {
+        auto inputFile = (path == "-"sv)
+                             ? wrapFile(stdin)
+                             : openFile(std::string{path}.c_str(), "rb");
+        if (!inputFile) {
+            fmt::print(stderr, "failed to open '{}' file to read\n", path);
+            return EXIT_FAILURE;
+        }
+        readers.push_back(
+            std::make_unique<PartialReader>(std::move(inputFile), path));
+        if (readers.back()->isFailed()) {
+            return EXIT_FAILURE;
+        }
+        if (readers.back()->getWords() != readers.front()->getWords()) {
+            fmt::print(stderr,
+                       "'{}' is counted with word definition '{}', but '{}' "
+                       "is expected\n",
+                       path, readers.back()->getWords(),
+                       readers.front()->getWords());
+            return EXIT_FAILURE;
+        }
+    }
+
+    auto outputPath = positional.back();
+    auto outputFile = (outputPath == "-"sv)
+                          ? wrapFile(stdout)
+                          : openFile(std::string{outputPath}.c_str(), "wb");
+    if (!outputFile) {
+        fmt::print(stderr, "failed to open '{}' file to write\n", outputPath);
+        return EXIT_FAILURE;
+    }
+
+    timer.report("open files");
+
+    auto greater = [](const PartialReader * lhs, const PartialReader * rhs) {
+        return rhs->word() < lhs->word();
+    };
+    std::priority_queue<PartialReader *, std::vector<PartialReader *>,
+                        decltype(greater)>
+        heap{greater};
+    for (const auto & reader : readers) {
+        if (reader->next()) {
+            heap.push(reader.get());
+        }
+    }
+
+    std::unique_ptr<PartialWriter<>> partialWriter;
+    if (partialOutput) {
+        partialWriter = std::make_unique<PartialWriter<>>(
+            outputFile, readers.front()->getWords());
+    }
+    // words are merged in ascending order, so are offsets of them in words
+    std::vector<std::pair<uint64_t, std::size_t>> rank;
+    std::vector<char> words;
+
+    std::string word;
+    std::size_t inputWordCount = 0;
+    std::size_t wordCount = 0;
+    while (!heap.empty()) {
+        word = heap.top()->word();
+        uint64_t count = 0;
+        while (!heap.empty() && (heap.top()->word() == word)) {
+            PartialReader * reader = heap.top();
+            heap.pop();
+            count += reader->count();
+            ++inputWordCount;
+            if (reader->next()) {
+                heap.push(reader);
+            }
+        }
+        ++wordCount;
+        if (partialWriter) {
+            if (!partialWriter->write(word, count)) {
+                fmt::print(stderr, "output failure\n");
+                return EXIT_FAILURE;
+            }
+        } else {
+            rank.emplace_back(count, words.size());
+            words.insert(std::cend(words), std::cbegin(word), std::cend(word));
+            words.push_back('\0');
+        }
+    }
+    for (const auto & reader : readers) {
+        if (!reader->isFinished()) {
+            return EXIT_FAILURE;
+        }
+    }
+    fmt::print(stderr, "{} words merged into {}\n", inputWordCount,
+               wordCount);
+    timer.report(fmt::format(fg(fmt::color::dark_blue), "merge partials"));
+
+    if (partialWriter) {
+        if (!partialWriter->finish()) {
+            fmt::print(stderr, "output failure\n");
+            return EXIT_FAILURE;
+        }
+        timer.report("write output");
+        return EXIT_SUCCESS;
+    }
+
+    std::stable_sort(std::begin(rank), std::end(rank), RankCountLess{});
+    timer.report(fmt::format(fg(fmt::color::dark_orange), "sort words"));
+
+    OutputStream<> outputStream{outputFile};
+    for (const auto & [count, word] : rank) {
+        if (!outputStream.print(count)) {
+            fmt::print(stderr, "output failure\n");
+            return EXIT_FAILURE;
+        }
+        if (!outputStream.putChar(' ')) {
+            fmt::print(stderr, "output failure\n");
+            return EXIT_FAILURE;
+        }
+        if (!outputStream.print(std::next(words.data(), word))) {
+            fmt::print(stderr, "output failure\n");
+            return EXIT_FAILURE;
+        }
+        if (!outputStream.putChar('\n')) {
+            fmt::print(stderr, "output failure\n");
+            return EXIT_FAILURE;
+        }
+    }
+    timer.report("write output");
+
+    return EXIT_SUCCESS;
+}
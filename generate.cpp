@@ -0,0 +1,140 @@
+#include "corpus.hpp"
+#include "io.hpp"
+#include "options.hpp"
+#include "timer.hpp"
+
+#include <fmt/color.h>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+int main(int argc, char * argv[])
+{
+    Timer timer{fmt::format(fg(fmt::color::dark_green), "total")};
+
+    Options options{argc, argv};
+    if (options.getPositional().size() != 2) {
+        fmt::print(stderr,
+                   "usage: {} [--size=1M] [--vocabulary=100000] [--zipf=1.0] "
+                   "[--min-length=1] [--max-length=20] [--mean-length=7.0] "
+                   "[--capitalized=0.0] [--uppercase=0.0] [--punctuation=0.0] "
+                   "[--seed=0] corpus.txt expected.txt\n",
+                   argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    CorpusParameters parameters;
+    if (!options.getSize("size", parameters.size) ||
+        !options.get("vocabulary", parameters.vocabularySize) ||
+        !options.get("zipf", parameters.zipfExponent) ||
+        !options.get("min-length", parameters.minWordLength) ||
+        !options.get("max-length", parameters.maxWordLength) ||
+        !options.get("mean-length", parameters.meanWordLength) ||
+        !options.get("capitalized", parameters.capitalizedProbability) ||
+        !options.get("uppercase", parameters.uppercaseProbability) ||
+        !options.get("punctuation", parameters.punctuationProbability) ||
+        !options.get("seed", parameters.seed))
+    {
+        return EXIT_FAILURE;
+    }
+    if (parameters.vocabularySize == 0 || parameters.minWordLength == 0 ||
+        parameters.minWordLength > parameters.maxWordLength ||
+        parameters.zipfExponent < 0.0)
+    {
+        fmt::print(stderr, "invalid corpus parameters\n");
+        return EXIT_FAILURE;
+    }
+
+    using namespace std::string_view_literals;
+
+    auto corpusPath = options.getPositional()[0];
+    auto corpusFile = (corpusPath == "-"sv)
+                          ? wrapFile(stdout)
+                          : openFile(std::string{corpusPath}.c_str(), "wb");
+    if (!corpusFile) {
+        fmt::print(stderr, "failed to open '{}' file to write\n", corpusPath);
+        return EXIT_FAILURE;
+    }
+
+    auto expectedPath = std::string{options.getPositional()[1]};
+    auto expectedFile = openFile(expectedPath.c_str(), "wb");
+    if (!expectedFile) {
+        fmt::print(stderr, "failed to open '{}' file to write\n", expectedPath);
+        return EXIT_FAILURE;
+    }
+
+    timer.report("open files");
+
+    Random random{parameters.seed};
+    Vocabulary vocabulary{parameters, random};
+    if (vocabulary.size() != parameters.vocabularySize) {
+        fmt::print(stderr,
+                   "only {} unique words fit into word length limits\n",
+                   vocabulary.size());
+        return EXIT_FAILURE;
+    }
+    timer.report("generate vocabulary");
+
+    std::vector<uint64_t> counts(vocabulary.size());
+    {
+        OutputStream<> outputStream{corpusFile};
+        bool failed = false;
+        auto onWord = [&](uint64_t index) { ++counts[index]; };
+        auto onText = [&](std::string_view text) {
+            failed |= !outputStream.print(text);
+        };
+        generateCorpus(parameters, vocabulary, random, onWord, onText);
+        if (failed || !outputStream.flush()) {
+            fmt::print(stderr, "output failure\n");
+            return EXIT_FAILURE;
+        }
+    }
+    timer.report(fmt::format(fg(fmt::color::dark_blue), "write corpus"));
+
+    std::vector<uint64_t> rank;
+    for (uint64_t index = 0; index < counts.size(); ++index) {
+        if (counts[index] != 0) {
+            rank.push_back(index);
+        }
+    }
+    fmt::print(stderr, "{} unique words of {} used\n", rank.size(),
+               vocabulary.size());
+    auto less = [&](uint64_t lhs, uint64_t rhs) {
+        return std::make_tuple(counts[rhs], vocabulary[lhs]) <
+               std::make_tuple(counts[lhs], vocabulary[rhs]);
+    };
+    std::sort(std::begin(rank), std::end(rank), less);
+    timer.report(fmt::format(fg(fmt::color::dark_orange), "sort words"));
+
+    OutputStream<> outputStream{expectedFile};
+    for (uint64_t index : rank) {
+        if (!outputStream.print(counts[index])) {
+            fmt::print(stderr, "output failure\n");
+            return EXIT_FAILURE;
+        }
+        if (!outputStream.putChar(' ')) {
+            fmt::print(stderr, "output failure\n");
+            return EXIT_FAILURE;
+        }
+        if (!outputStream.print(vocabulary.c_str(index))) {
+            fmt::print(stderr, "output failure\n");
+            return EXIT_FAILURE;
+        }
+        if (!outputStream.putChar('\n')) {
+            fmt::print(stderr, "output failure\n");
+            return EXIT_FAILURE;
+        }
+    }
+    timer.report("write expected output");
+
+    return EXIT_SUCCESS;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>
+#include <memory>
 #include <new>
 
 #include <cassert>
@@ -34,6 +35,23 @@ inline constexpr std::size_t kHardwareConstructiveInterferenceSize = 64;
 inline constexpr std::size_t kHardwareDestructiveInterferenceSize = 64;
 #endif
 
+// 16-byte aligned char buffer, so that input in it is loaded by
+// _mm_load_si128()
+struct AlignedDeleter
+{
+    void operator()(char * p) const
+    {
+        operator delete[](p, std::align_val_t{sizeof(__m128i)});
+    }
+};
+
+using AlignedBuffer = std::unique_ptr<char[], AlignedDeleter>;
+
+inline AlignedBuffer makeAlignedBuffer(std::size_t size)
+{
+    return AlignedBuffer{new (std::align_val_t{sizeof(__m128i)}) char[size]};
+}
+
 inline void toLower(char * beg, char * const end)
 {
     assert(beg <= end);
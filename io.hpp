@@ -4,8 +4,21 @@
 
 #include <fmt/format.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
 #include <iterator>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
 
 #include <cassert>
 #include <cstdio>
@@ -23,26 +36,334 @@ inline File openFile(const char * filename, const char * modes)
     return wrapFile(std::fopen(filename, modes));
 }
 
-inline std::size_t readInput(char * inputBegin, std::size_t inputSize,
-                             const File & inputFile)
+// Whole file in a 16-byte aligned buffer, padded with NULs to a multiple of
+// sizeof(__m128i) like readInput() does; at least one NUL follows the last word
+// to terminate it for a key comparison. The buffer is reused between files
+class InputBuffer
 {
-    std::size_t readSize =
-        std::fread(inputBegin, 1, inputSize, inputFile.get());
+public:
+    bool read(const std::string & path)
+    {
+        auto inputFile = openFile(path.c_str(), "rb");
+        if (!inputFile) {
+            return false;
+        }
+        std::error_code errorCode;
+        auto fileSize = std::filesystem::file_size(path, errorCode);
+        if (errorCode) {
+            return false;
+        }
+        auto paddedSize = (std::size_t(fileSize) + sizeof(__m128i)) /
+                          sizeof(__m128i) * sizeof(__m128i);
+        if (paddedSize > capacity) {
+            capacity = std::max(paddedSize, capacity * 2);
+            storage = makeAlignedBuffer(capacity);
+        }
+        size = std::fread(storage.get(), 1, fileSize, inputFile.get());
+        if (size != fileSize) {
+            return false;
+        }
+        std::fill(end(), std::next(begin(), paddedSize), '\0');
+        size = paddedSize;
+        return true;
+    }
+
+    char * begin() const
+    {
+        return storage.get();
+    }
+
+    char * end() const
+    {
+        return std::next(storage.get(), size);
+    }
+
+private:
+    AlignedBuffer storage;
+    std::size_t capacity = 0;
+    std::size_t size = 0;
+};
+
+// Source of a stream: fills [buffer, buffer + size) and returns the number of
+// bytes, which is less than size only at the end of stream, or -1 on failure
+using Source = std::function<std::ptrdiff_t(char * buffer, std::size_t size)>;
+
+// prefix is bytes already read from inputFile, e.g. to detect its format
+inline Source makeFileSource(const File & inputFile, std::string prefix = {})
+{
+    return [file = inputFile.get(), prefix = std::move(prefix)](
+               char * buffer, std::size_t size) mutable -> std::ptrdiff_t {
+        std::size_t prefixSize = std::min(prefix.size(), size);
+        std::copy_n(prefix.data(), prefixSize, buffer);
+        prefix.erase(0, prefixSize);
+        std::size_t readSize = prefixSize;
+        if (readSize < size) {
+            readSize += std::fread(std::next(buffer, std::ptrdiff_t(readSize)),
+                                   1, size - readSize, file);
+            if (std::ferror(file) != 0) {
+                return -1;
+            }
+        }
+        return std::ptrdiff_t(readSize);
+    };
+}
+
+// Reads the whole input from source and pads it with NULs to a multiple of
+// sizeof(__m128i). Returns the padded size, or -1 on failure (a read error or
+// too large input), so that it is not taken for empty input
+inline std::ptrdiff_t readInput(char * inputBegin, std::size_t inputSize,
+                                const Source & source)
+{
+    std::ptrdiff_t readSize = source(inputBegin, inputSize);
+    if (readSize < 0) {
+        fmt::print(stderr, "failed to read input\n");
+        return -1;
+    }
     fmt::print(stderr, "input size = {} bytes\n", readSize);
-    if (!(readSize < inputSize)) {
+    if (!(std::size_t(readSize) < inputSize)) {
+        fmt::print(stderr, "input is too large\n");
+        return -1;
+    }
+    auto paddedSize = (std::size_t(readSize) + sizeof(__m128i) - 1) /
+                      sizeof(__m128i) * sizeof(__m128i);
+    if (paddedSize > inputSize) {
         fmt::print(stderr, "input is too large\n");
-        return 0;
+        return -1;
+    }
+    std::fill(std::next(inputBegin, readSize),
+              std::next(inputBegin, std::ptrdiff_t(paddedSize)), '\0');
+    return std::ptrdiff_t(paddedSize);
+}
+
+// Reads a stream by a thread into two alternating blocks, so that reading of
+// the next block overlaps processing of the current one. Blocks are 16-byte
+// aligned, all but the last one are kBlockSize bytes, the last one is padded
+// with at least one NUL to a multiple of sizeof(__m128i). A word straddling
+// blocks is made contiguous: next(carry) copies the last carry bytes of the
+// current block right before the next one.
+class AsyncReader
+{
+public:
+    static constexpr std::size_t kBlockSize = 1 << 22;
+    static constexpr std::size_t kMaxCarry = 1 << 16;
+
+    explicit AsyncReader(Source source)
+        : source{std::move(source)}, reader{[this] { read(); }}
+    {}
+
+    explicit AsyncReader(const File & inputFile)
+        : AsyncReader{makeFileSource(inputFile)}
+    {}
+
+    AsyncReader(const AsyncReader &) = delete;
+    AsyncReader & operator=(const AsyncReader &) = delete;
+
+    ~AsyncReader()
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex};
+            stopped = true;
+        }
+        condition.notify_all();
+        reader.join();
+    }
+
+    // makes the next block current, false at the end of stream or on failure
+    bool next(std::size_t carry = 0)
+    {
+        if (current && current->last) {
+            return false;
+        }
+        if (carry > kMaxCarry) {
+            fmt::print(stderr, "word is longer than {} bytes\n", kMaxCarry);
+            failed = true;
+            return false;
+        }
+        Block & block = blocks[blockIndex];
+        {
+            auto start = std::chrono::steady_clock::now();
+            std::unique_lock<std::mutex> lock{mutex};
+            condition.wait(lock, [&block] { return block.full; });
+            waitTime += std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+        }
+        if (current) {
+            std::copy_n(std::prev(current->end(), std::ptrdiff_t(carry)),
+                        carry, std::prev(block.begin(), std::ptrdiff_t(carry)));
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                current->full = false;
+            }
+            condition.notify_all();
+        }
+        current = &block;
+        blockIndex ^= 1;
+        if (block.failed) {
+            fmt::print(stderr, "failed to read input\n");
+            failed = true;
+            return false;
+        }
+        return true;
     }
 
-    inputBegin += readSize;
-    while ((readSize % sizeof(__m128i)) != 0) {
-        *inputBegin++ = '\0';
-        if (++readSize > inputSize) {
-            fmt::print(stderr, "input is too large\n");
-            return 0;
+    char * begin() const
+    {
+        return current->begin();
+    }
+
+    char * end() const
+    {
+        return current->end();
+    }
+
+    bool isFailed() const
+    {
+        return failed;
+    }
+
+    // bytes read so far, without padding
+    std::size_t getReadSize() const
+    {
+        return readSize.load(std::memory_order_relaxed);
+    }
+
+    // seconds spent by the reader thread in the source, valid at the end of
+    // stream
+    double getReadTime() const
+    {
+        return readTime;
+    }
+
+    // seconds spent by next() waiting for the reader thread
+    double getWaitTime() const
+    {
+        return waitTime;
+    }
+
+private:
+    struct Block
+    {
+        AlignedBuffer storage =
+            makeAlignedBuffer(kMaxCarry + kBlockSize + sizeof(__m128i));
+        std::size_t size = 0;
+        bool last = false;
+        bool failed = false;
+        bool full = false;  // guarded by AsyncReader::mutex
+
+        char * begin() const
+        {
+            return std::next(storage.get(), kMaxCarry);
+        }
+
+        char * end() const
+        {
+            return std::next(begin(), std::ptrdiff_t(size));
+        }
+    };
+
+    const Source source;
+    Block blocks[2];
+    std::size_t blockIndex = 0;
+    Block * current = nullptr;
+    bool failed = false;
+    std::atomic<std::size_t> readSize = 0;
+    double readTime = 0.0;  // published along with the last block
+    double waitTime = 0.0;
+    std::mutex mutex;
+    bool stopped = false;  // guarded by mutex
+    std::condition_variable condition;
+    std::thread reader;
+
+    void read()
+    {
+        for (std::size_t index = 0;; index ^= 1) {
+            Block & block = blocks[index];
+            {
+                std::unique_lock<std::mutex> lock{mutex};
+                condition.wait(lock, [this, &block] {
+                    return !block.full || stopped;
+                });
+                if (stopped) {
+                    return;
+                }
+            }
+            auto start = std::chrono::steady_clock::now();
+            std::ptrdiff_t size = source(block.begin(), kBlockSize);
+            readTime += std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+            block.failed = (size < 0);
+            block.size = block.failed ? 0 : std::size_t(size);
+            readSize.fetch_add(block.size, std::memory_order_relaxed);
+            block.last = (block.size != kBlockSize);
+            if (block.last) {
+                auto paddedSize = (block.size + sizeof(__m128i)) /
+                                  sizeof(__m128i) * sizeof(__m128i);
+                std::fill(block.end(), std::next(block.begin(), paddedSize),
+                          '\0');
+                block.size = paddedSize;
+            }
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                block.full = true;
+            }
+            condition.notify_all();
+            if (block.last) {
+                return;
+            }
         }
     }
-    return readSize;
+};
+
+struct InputFileInfo
+{
+    std::string path;
+    std::uintmax_t size;
+};
+
+// Regular files of paths, directories are traversed recursively; largest
+// first, so that the longest jobs are scheduled earliest
+inline bool listInputFiles(const std::vector<std::string_view> & paths,
+                           std::vector<InputFileInfo> & files)
+{
+    namespace fs = std::filesystem;
+    std::error_code errorCode;
+    auto addFile = [&](const fs::path & path) {
+        auto size = fs::file_size(path, errorCode);
+        if (errorCode) {
+            fmt::print(stderr, "failed to get size of '{}': {}\n",
+                       path.string(), errorCode.message());
+            return false;
+        }
+        files.push_back({path.string(), size});
+        return true;
+    };
+    for (std::string_view path : paths) {
+        if (!fs::is_directory(path, errorCode)) {
+            if (!addFile(path)) {
+                return false;
+            }
+            continue;
+        }
+        for (fs::recursive_directory_iterator it{path, errorCode}, end;
+             !errorCode && (it != end); it.increment(errorCode))
+        {
+            if (it->is_regular_file(errorCode) && !addFile(it->path())) {
+                return false;
+            }
+        }
+        if (errorCode) {
+            fmt::print(stderr, "failed to list directory '{}': {}\n", path,
+                       errorCode.message());
+            return false;
+        }
+    }
+    std::stable_sort(std::begin(files), std::end(files),
+                     [](const InputFileInfo & lhs, const InputFileInfo & rhs) {
+                         return rhs.size < lhs.size;
+                     });
+    return true;
 }
 
 template<std::size_t bufferSize = 131072>
@@ -121,6 +442,22 @@ public:
         return true;
     }
 
+    bool print(std::string_view s)
+    {
+        while (!s.empty()) {
+            auto size = std::min(
+                s.size(), std::size_t(std::distance(o, std::end(output))));
+            o = std::copy_n(s.data(), size, o);
+            s.remove_prefix(size);
+            if (o == std::end(output)) {
+                if (!flush()) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
     FORCEINLINE bool print(const char * s)
     {
         while (*s != '\0') {
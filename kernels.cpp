@@ -0,0 +1,659 @@
+#include "charclass.hpp"
+#include "corpus.hpp"
+#include "helpers.hpp"
+#include "io.hpp"
+#include "memory.hpp"
+#include "mphf.hpp"
+#include "ngram.hpp"
+#include "oaph.hpp"
+#include "rank.hpp"
+#include "spacesaving.hpp"
+#include "sparsest.hpp"
+#include "tokenizer.hpp"
+#include "utf8.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+
+// NUL-padded to a multiple of sizeof(__m128i) with at least one extra block
+class Corpus
+{
+public:
+    Corpus(uint64_t size, uint64_t vocabularySize)
+    {
+        CorpusParameters parameters;
+        parameters.size = size;
+        parameters.vocabularySize = vocabularySize;
+        parameters.capitalizedProbability = 0.1;
+        parameters.punctuationProbability = 0.1;
+        Random random{parameters.seed};
+        Vocabulary vocabulary{parameters, random};
+        std::string text;
+        text.reserve(size + 64);
+        auto onWord = [](uint64_t) {};
+        auto onText = [&text](std::string_view s) { text.append(s); };
+        generateCorpus(parameters, vocabulary, random, onWord, onText);
+        text.resize(std::min<std::size_t>(text.size(), size));
+        capacity = (text.size() / sizeof(__m128i) + 2) * sizeof(__m128i);
+        storage = makeAlignedBuffer(capacity);
+        std::fill(std::copy(std::cbegin(text), std::cend(text), begin()),
+                  std::next(begin(), capacity), '\0');
+        end_ = std::next(begin(),
+                         (text.size() + sizeof(__m128i) - 1) /
+                             sizeof(__m128i) * sizeof(__m128i));
+    }
+
+    char * begin() const
+    {
+        return storage.get();
+    }
+
+    char * end() const
+    {
+        return end_;
+    }
+
+    std::size_t size() const
+    {
+        return std::size_t(std::distance(begin(), end()));
+    }
+
+    Corpus copy() const
+    {
+        return Corpus{*this};
+    }
+
+private:
+    AlignedBuffer storage;
+    std::size_t capacity = 0;
+    char * end_ = nullptr;
+
+    Corpus(const Corpus & corpus) : capacity{corpus.capacity}
+    {
+        storage = makeAlignedBuffer(capacity);
+        std::copy_n(corpus.begin(), capacity, begin());
+        end_ = std::next(begin(), corpus.size());
+    }
+};
+
+const Corpus & getCorpus(const benchmark::State & state)
+{
+    static std::map<std::pair<int64_t, int64_t>, Corpus> corpora;
+    auto key = std::make_pair(state.range(0), state.range(1));
+    auto it = corpora.find(key);
+    if (it == corpora.end()) {
+        it = corpora
+                 .emplace(std::piecewise_construct, std::forward_as_tuple(key),
+                          std::forward_as_tuple(uint64_t(key.first),
+                                                uint64_t(key.second)))
+                 .first;
+    }
+    return it->second;
+}
+
+struct Word
+{
+    uint32_t hash;
+    const char * wordEnd;
+    uint32_t len;
+};
+
+template<bool kInputIsLowercase>
+std::vector<Word> getWords(const Corpus & corpus, uint32_t initialChecksum)
+{
+    std::vector<Word> words;
+    uint32_t hash = initialChecksum;
+    uint32_t len = 0;
+    auto onWord = [&words](uint32_t hash, const char * wordEnd, uint32_t len) {
+        words.push_back({hash, wordEnd, len});
+    };
+    tokenize<kInputIsLowercase>(corpus.begin(), corpus.end(), initialChecksum,
+                                hash, len, onWord);
+    return words;
+}
+
+std::vector<std::pair<uint32_t, std::string_view>> getRank(
+    const Corpus & corpus)
+{
+    std::unordered_map<std::string_view, uint32_t> wordCounts;
+    auto onWord = [&](uint32_t, const char * wordEnd, uint32_t len) {
+        ++wordCounts[std::string_view{std::prev(wordEnd, len), len}];
+    };
+    uint32_t hash = 0;
+    uint32_t len = 0;
+    tokenize<true>(corpus.begin(), corpus.end(), 0, hash, len, onWord);
+    std::vector<std::pair<uint32_t, std::string_view>> rank;
+    rank.reserve(wordCounts.size());
+    for (const auto & [word, count] : wordCounts) {
+        rank.emplace_back(count, word);
+    }
+    return rank;
+}
+
+void setProcessed(benchmark::State & state, std::size_t bytes,
+                  std::size_t items)
+{
+    if (bytes != 0) {
+        state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(bytes));
+    }
+    if (items != 0) {
+        state.SetItemsProcessed(int64_t(state.iterations()) * int64_t(items));
+    }
+}
+
+void BM_ToLower(benchmark::State & state)
+{
+    Corpus corpus = getCorpus(state).copy();
+    for (auto _ : state) {
+        toLower(corpus.begin(), corpus.end());
+        benchmark::ClobberMemory();
+    }
+    setProcessed(state, corpus.size(), 0);
+}
+
+// ASCII corpus, i.e. overhead of the UTF-8 mode compared to BM_ToLower
+void BM_FoldUtf8(benchmark::State & state)
+{
+    Corpus corpus = getCorpus(state).copy();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(foldUtf8(corpus.begin(), corpus.end()));
+        benchmark::ClobberMemory();
+    }
+    setProcessed(state, corpus.size(), 0);
+}
+
+template<bool kInputIsLowercase, typename CharClass = charclass::Alpha>
+void BM_Tokenize(benchmark::State & state)
+{
+    Corpus corpus = getCorpus(state).copy();
+    if (kInputIsLowercase) {
+        toLower<CharClass>(corpus.begin(), corpus.end());
+    }
+    std::size_t wordCount = 0;
+    for (auto _ : state) {
+        uint32_t hash = oaph::kInitialChecksum;
+        uint32_t len = 0;
+        uint32_t sink = 0;
+        wordCount = 0;
+        auto onWord = [&](uint32_t hash, const char *, uint32_t len) {
+            sink += hash + len;
+            ++wordCount;
+        };
+        tokenize<kInputIsLowercase, CharClass>(corpus.begin(), corpus.end(),
+                                               oaph::kInitialChecksum, hash,
+                                               len, onWord);
+        benchmark::DoNotOptimize(sink);
+    }
+    setProcessed(state, corpus.size(), wordCount);
+}
+
+// open addressing is required for corpora other than pg.txt
+oaph::HashTable</* kEnableOpenAddressing */ true> oaphHashTable;
+
+void BM_OaphIncCounter(benchmark::State & state)
+{
+    Corpus corpus = getCorpus(state).copy();
+    toLower(corpus.begin(), corpus.end());
+    auto words = getWords<true>(corpus, oaph::kInitialChecksum);
+    oaphHashTable.init();
+    for (auto _ : state) {
+        for (const Word & word : words) {
+            oaphHashTable.incCounter(word.hash, word.wordEnd, word.len);
+        }
+        benchmark::ClobberMemory();
+    }
+    setProcessed(state, corpus.size(), words.size());
+}
+
+// tokenize() and incCounter(), the baseline of BM_OaphCountNGrams
+void BM_OaphCountWords(benchmark::State & state)
+{
+    Corpus corpus = getCorpus(state).copy();
+    toLower(corpus.begin(), corpus.end());
+    oaphHashTable.init();
+    for (auto _ : state) {
+        oaphHashTable.countWords(corpus.begin(), corpus.end());
+        benchmark::ClobberMemory();
+    }
+    setProcessed(state, corpus.size(), 0);
+}
+
+template<std::size_t kN>
+void BM_OaphCountNGrams(benchmark::State & state)
+{
+    static auto nGramTable = mapZeroed<oaph::NGramTable<kN>>();
+    Corpus corpus = getCorpus(state).copy();
+    toLower(corpus.begin(), corpus.end());
+    oaphHashTable.init();
+    nGramTable->init();
+    for (auto _ : state) {
+        oaph::NGramCounter<kN, /* kEnableOpenAddressing */ true,
+                           charclass::Alpha>
+            nGramCounter{oaphHashTable, *nGramTable};
+        uint32_t hash = oaph::kInitialChecksum;
+        uint32_t len = 0;
+        nGramCounter.countWords(corpus.begin(), corpus.end(), hash, len);
+        nGramCounter.finish(hash, corpus.end(), len);
+        benchmark::ClobberMemory();
+    }
+    setProcessed(state, corpus.size(), 0);
+}
+
+void BM_SparsestIncCounter(benchmark::State & state)
+{
+    static auto hashTable = mapZeroed<sparsest::HashTable>();
+    const Corpus & corpus = getCorpus(state);
+    auto words = getWords<false>(corpus, sparsest::kInitialChecksum);
+    hashTable->init();
+    for (auto _ : state) {
+        for (const Word & word : words) {
+            hashTable->incCounter(word.hash, word.wordEnd, word.len);
+        }
+        benchmark::ClobberMemory();
+    }
+    setProcessed(state, corpus.size(), words.size());
+}
+
+// counting by a minimal perfect hash dictionary of all words of the corpus,
+// see dict.cpp
+void BM_MphfFind(benchmark::State & state)
+{
+    Corpus corpus = getCorpus(state).copy();
+    toLower(corpus.begin(), corpus.end());
+    auto words = getWords<true>(corpus, mphf::kInitialChecksum);
+    std::vector<std::string_view> vocabulary;
+    for (const auto & [count, word] : getRank(corpus)) {
+        vocabulary.push_back(word);
+    }
+    std::vector<char> data;
+    std::vector<std::string_view> collisions;
+    if (!mphf::build(vocabulary, data, collisions)) {
+        state.SkipWithError("failed to build minimal perfect hash");
+        return;
+    }
+    mphf::Dictionary dictionary{data.data()};
+    std::vector<uint64_t> counts(dictionary.size() + 1, 0);
+    for (auto _ : state) {
+        for (const Word & word : words) {
+            ++counts[dictionary.find(word.hash, word.wordEnd, word.len)];
+        }
+        benchmark::ClobberMemory();
+    }
+    state.counters["function"] = benchmark::Counter(
+        double(mphf::Sections{dictionary.getLayout()}.keys),
+        benchmark::Counter::kDefaults, benchmark::Counter::OneK::kIs1024);
+    setProcessed(state, corpus.size(), words.size());
+}
+
+// Space-Saving summary of the corpus against exact counts: the throughput is
+// comparable to BM_OaphIncCounter, "recall" is the share of the exact top 100
+// words in the reported top 100, "error" is the largest overestimation of
+// them relative to the exact count
+void BM_SpaceSaving(benchmark::State & state)
+{
+    constexpr std::size_t kTop = 100;
+    Corpus corpus = getCorpus(state).copy();
+    toLower(corpus.begin(), corpus.end());
+    auto words = getWords<true>(corpus, oaph::kInitialChecksum);
+    auto capacity = std::size_t(state.range(2));
+    std::vector<SpaceSaving::Counter> counters;
+    for (auto _ : state) {
+        SpaceSaving spaceSaving{capacity};
+        for (const Word & word : words) {
+            spaceSaving.add(word.hash,
+                            {std::prev(word.wordEnd, word.len), word.len});
+        }
+        state.PauseTiming();
+        counters = spaceSaving.getCounters();
+        state.ResumeTiming();
+    }
+    auto rank = getRank(corpus);
+    std::unordered_map<std::string_view, uint32_t> exactCounts;
+    for (const auto & [count, word] : rank) {
+        exactCounts.emplace(word, count);
+    }
+    auto top = std::min({kTop, rank.size(), counters.size()});
+    std::partial_sort(std::begin(rank), std::next(std::begin(rank), top),
+                      std::end(rank), RankLess{});
+    auto counterLess = [](const auto & lhs, const auto & rhs) {
+        return rhs.count < lhs.count;
+    };
+    std::partial_sort(std::begin(counters),
+                      std::next(std::begin(counters), top),
+                      std::end(counters), counterLess);
+    std::size_t found = 0;
+    double error = 0.0;
+    for (std::size_t i = 0; i < top; ++i) {
+        const auto & [count, counterError, word, hash] = counters[i];
+        auto isWord = [&word](const auto & wordCount) {
+            return wordCount.second == word;
+        };
+        if (std::any_of(std::cbegin(rank), std::next(std::cbegin(rank), top),
+                        isWord))
+        {
+            ++found;
+        }
+        uint32_t exactCount = exactCounts[word];
+        error = std::max(error, double(count - exactCount) /
+                                    double(std::max<uint32_t>(exactCount, 1)));
+    }
+    state.counters["recall"] =
+        double(found) / double(std::max<std::size_t>(top, 1));
+    state.counters["error"] = error;
+    setProcessed(state, corpus.size(), words.size());
+}
+
+// oaph::Chunk with plain 64-bit counters, which straddles cache lines
+struct WideChunk
+{
+    __m128i hashesHigh;
+    uint64_t count[std::extent_v<decltype(oaph::Chunk::count)>];
+};
+
+// slot of chunks addressed like in oaph::HashTable, the index depends on tags
+// to keep the load of them
+template<typename Chunk>
+std::pair<uint32_t, uint32_t> getSlot(const Chunk * chunks, uint32_t hash)
+{
+    uint32_t hashLow = hash & oaph::kHashTableMask;
+    __m128i hashesHigh = _mm_load_si128(&chunks[hashLow].hashesHigh);
+    uint32_t index = (uint32_t(_mm_cvtsi128_si32(hashesHigh)) ^
+                      (hash >> oaph::kHashTableOrder)) %
+                     std::extent_v<decltype(Chunk::count)>;
+    return {hashLow, index};
+}
+
+struct NarrowCounters
+{
+    oaph::Chunk chunks[1 << oaph::kHashTableOrder];
+    uint64_t spills[std::extent_v<decltype(chunks)>]
+                   [std::extent_v<decltype(oaph::Chunk::count)>];
+
+    void incCounter(uint32_t hash)
+    {
+        auto [hashLow, index] = getSlot(chunks, hash);
+        oaph::addCount(chunks[hashLow].count[index], spills[hashLow][index],
+                       1);
+    }
+};
+
+struct WideCounters
+{
+    WideChunk chunks[1 << oaph::kHashTableOrder];
+
+    void incCounter(uint32_t hash)
+    {
+        auto [hashLow, index] = getSlot(chunks, hash);
+        ++chunks[hashLow].count[index];
+    }
+};
+
+// counters of oaph::HashTable alone: 16-bit ones with spills against plain
+// 64-bit ones, "chunks" is the footprint of the hot part
+template<typename Counters>
+void BM_CounterIncrement(benchmark::State & state)
+{
+    static auto counters = mapZeroed<Counters>();
+    const Corpus & corpus = getCorpus(state);
+    auto words = getWords<false>(corpus, oaph::kInitialChecksum);
+    for (auto _ : state) {
+        for (const Word & word : words) {
+            counters->incCounter(word.hash);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.counters["chunks"] =
+        benchmark::Counter(double(sizeof counters->chunks),
+                           benchmark::Counter::kDefaults,
+                           benchmark::Counter::OneK::kIs1024);
+    setProcessed(state, corpus.size(), words.size());
+}
+
+void BM_OutputStreamPrintCount(benchmark::State & state)
+{
+    Corpus corpus = getCorpus(state).copy();
+    toLower(corpus.begin(), corpus.end());
+    auto rank = getRank(corpus);
+    auto outputFile = openFile("/dev/null", "wb");
+    OutputStream<> outputStream{outputFile};
+    for (auto _ : state) {
+        for (const auto & [count, word] : rank) {
+            outputStream.print(count);
+            outputStream.putChar(' ');
+        }
+    }
+    setProcessed(state, 0, rank.size());
+}
+
+void BM_OutputStreamPrintWord(benchmark::State & state)
+{
+    Corpus corpus = getCorpus(state).copy();
+    toLower(corpus.begin(), corpus.end());
+    auto rank = getRank(corpus);  // words are NUL-terminated in corpus
+    std::size_t bytes = 0;
+    for (const auto & [count, word] : rank) {
+        bytes += word.size() + 1;
+    }
+    auto outputFile = openFile("/dev/null", "wb");
+    OutputStream<> outputStream{outputFile};
+    for (auto _ : state) {
+        for (const auto & [count, word] : rank) {
+            outputStream.print(word.data());
+            outputStream.putChar('\n');
+        }
+    }
+    setProcessed(state, bytes, rank.size());
+}
+
+void BM_RankSort(benchmark::State & state)
+{
+    Corpus corpus = getCorpus(state).copy();
+    toLower(corpus.begin(), corpus.end());
+    const auto rank = getRank(corpus);
+    auto sorted = rank;
+    for (auto _ : state) {
+        state.PauseTiming();
+        sorted = rank;
+        state.ResumeTiming();
+        std::sort(std::begin(sorted), std::end(sorted), RankLess{});
+    }
+    setProcessed(state, 0, rank.size());
+}
+
+void BM_RankStableSortByCount(benchmark::State & state)
+{
+    Corpus corpus = getCorpus(state).copy();
+    toLower(corpus.begin(), corpus.end());
+    auto rank = getRank(corpus);
+    std::sort(std::begin(rank), std::end(rank));
+    auto sorted = rank;
+    for (auto _ : state) {
+        state.PauseTiming();
+        sorted = rank;
+        state.ResumeTiming();
+        std::stable_sort(std::begin(sorted), std::end(sorted),
+                         RankCountLess{});
+    }
+    setProcessed(state, 0, rank.size());
+}
+
+// Words of a vocabulary in random order with counts of Zipf distribution, so
+// that most of counts tie, as in the tail of the rank of a large corpus
+class VocabularyRank
+{
+public:
+    explicit VocabularyRank(uint64_t vocabularySize)
+        : random{0}, vocabulary{getParameters(vocabularySize), random}
+    {
+        indices.resize(vocabulary.size());
+        for (std::size_t i = 0; i < indices.size(); ++i) {
+            indices[i] = uint32_t(i);
+        }
+        for (std::size_t i = indices.size(); i > 1; --i) {
+            std::swap(indices[i - 1], indices[random.below(i)]);
+        }
+    }
+
+    std::vector<std::pair<uint32_t, std::string_view>> getRank() const
+    {
+        std::vector<std::pair<uint32_t, std::string_view>> rank;
+        rank.reserve(indices.size());
+        for (uint32_t index : indices) {
+            rank.emplace_back(getCount(index), vocabulary[index]);
+        }
+        return rank;
+    }
+
+    // words are offsets from getArena()
+    std::vector<PrefixRankEntry<uint32_t>> getPrefixRank() const
+    {
+        std::vector<PrefixRankEntry<uint32_t>> rank;
+        rank.reserve(indices.size());
+        for (uint32_t index : indices) {
+            const char * word = vocabulary.c_str(index);
+            auto offset = std::distance(getArena(), word);
+            rank.push_back({getWordPrefix(word), getCount(index),
+                            uint32_t(offset)});
+        }
+        return rank;
+    }
+
+    const char * getArena() const
+    {
+        return vocabulary.c_str(0);
+    }
+
+private:
+    Random random;
+    Vocabulary vocabulary;
+    std::vector<uint32_t> indices;
+
+    static CorpusParameters getParameters(uint64_t vocabularySize)
+    {
+        CorpusParameters parameters;
+        parameters.vocabularySize = vocabularySize;
+        return parameters;
+    }
+
+    uint32_t getCount(uint32_t index) const
+    {
+        return uint32_t(vocabulary.size() / (index + 1));
+    }
+};
+
+const VocabularyRank & getVocabularyRank(const benchmark::State & state)
+{
+    static std::map<int64_t, std::unique_ptr<VocabularyRank>> vocabularyRanks;
+    auto & vocabularyRank = vocabularyRanks[state.range(0)];
+    if (!vocabularyRank) {
+        vocabularyRank =
+            std::make_unique<VocabularyRank>(uint64_t(state.range(0)));
+    }
+    return *vocabularyRank;
+}
+
+// ties are resolved by comparison of words scattered in memory
+void BM_VocabularyRankSort(benchmark::State & state)
+{
+    const auto rank = getVocabularyRank(state).getRank();
+    auto sorted = rank;
+    for (auto _ : state) {
+        state.PauseTiming();
+        sorted = rank;
+        state.ResumeTiming();
+        std::sort(std::begin(sorted), std::end(sorted), RankLess{});
+    }
+    setProcessed(state, 0, rank.size());
+}
+
+// ties are mostly resolved by comparison of inline prefixes of words
+void BM_VocabularyPrefixRankSort(benchmark::State & state)
+{
+    const auto & vocabularyRank = getVocabularyRank(state);
+    const auto rank = vocabularyRank.getPrefixRank();
+    const char * arena = vocabularyRank.getArena();
+    auto wordLess = [arena](uint32_t lhs, uint32_t rhs) {
+        return std::strcmp(std::next(arena, lhs), std::next(arena, rhs)) < 0;
+    };
+    auto sorted = rank;
+    for (auto _ : state) {
+        state.PauseTiming();
+        sorted = rank;
+        state.ResumeTiming();
+        std::sort(std::begin(sorted), std::end(sorted),
+                  PrefixRankLess{wordLess});
+    }
+    setProcessed(state, 0, rank.size());
+}
+
+// {vocabulary size}
+void vocabularyArguments(benchmark::internal::Benchmark * benchmark)
+{
+    benchmark->ArgName("vocabulary");
+    benchmark->RangeMultiplier(10)->Range(100000, 100000000);
+    benchmark->Unit(benchmark::kMillisecond);
+}
+
+// {corpus size in bytes, vocabulary size}
+void corpusArguments(benchmark::internal::Benchmark * benchmark)
+{
+    benchmark->ArgNames({"size", "vocabulary"});
+    benchmark->ArgsProduct({{1 << 16, 1 << 20, 1 << 24}, {1000, 100000}});
+}
+
+// {corpus size in bytes, vocabulary size, counters}: accuracy and throughput
+// curves by the number of counters
+void spaceSavingArguments(benchmark::internal::Benchmark * benchmark)
+{
+    benchmark->ArgNames({"size", "vocabulary", "capacity"});
+    benchmark->ArgsProduct(
+        {{1 << 24}, {1000, 100000}, {256, 1024, 4096, 16384, 65536}});
+}
+
+}  // namespace
+
+BENCHMARK(BM_ToLower)->Apply(corpusArguments);
+BENCHMARK(BM_FoldUtf8)->Apply(corpusArguments);
+BENCHMARK_TEMPLATE(BM_Tokenize, false)->Apply(corpusArguments);
+BENCHMARK_TEMPLATE(BM_Tokenize, true)->Apply(corpusArguments);
+BENCHMARK_TEMPLATE(BM_Tokenize, false, charclass::Identifier)
+    ->Apply(corpusArguments);
+BENCHMARK_TEMPLATE(BM_Tokenize, false, charclass::Apostrophe)
+    ->Apply(corpusArguments);
+BENCHMARK(BM_OaphIncCounter)->Apply(corpusArguments);
+BENCHMARK(BM_OaphCountWords)->Apply(corpusArguments);
+BENCHMARK_TEMPLATE(BM_OaphCountNGrams, 2)->Apply(corpusArguments);
+BENCHMARK_TEMPLATE(BM_OaphCountNGrams, 3)->Apply(corpusArguments);
+BENCHMARK(BM_SparsestIncCounter)->Apply(corpusArguments);
+BENCHMARK(BM_MphfFind)->Apply(corpusArguments);
+BENCHMARK(BM_SpaceSaving)->Apply(spaceSavingArguments);
+BENCHMARK_TEMPLATE(BM_CounterIncrement, NarrowCounters)
+    ->Apply(corpusArguments);
+BENCHMARK_TEMPLATE(BM_CounterIncrement, WideCounters)->Apply(corpusArguments);
+BENCHMARK(BM_OutputStreamPrintCount)->Apply(corpusArguments);
+BENCHMARK(BM_OutputStreamPrintWord)->Apply(corpusArguments);
+BENCHMARK(BM_RankSort)->Apply(corpusArguments);
+BENCHMARK(BM_RankStableSortByCount)->Apply(corpusArguments);
+BENCHMARK(BM_VocabularyRankSort)->Apply(vocabularyArguments);
+BENCHMARK(BM_VocabularyPrefixRankSort)->Apply(vocabularyArguments);
+
+BENCHMARK_MAIN();
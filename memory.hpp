@@ -0,0 +1,82 @@
+#pragma once
+
+#include <memory>
+#include <new>
+#include <type_traits>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+struct MemoryUsage
+{
+    std::size_t rss = 0;      // bytes, from /proc/self/statm
+    std::size_t peakRss = 0;  // bytes, ru_maxrss
+    std::size_t minorFaults = 0;
+    std::size_t majorFaults = 0;
+
+    static MemoryUsage current()
+    {
+        MemoryUsage memoryUsage;
+        if (std::FILE * statm = std::fopen("/proc/self/statm", "rb")) {
+            unsigned long long size = 0, resident = 0;
+            if (std::fscanf(statm, "%llu %llu", &size, &resident) == 2) {
+                memoryUsage.rss =
+                    std::size_t(resident) * std::size_t(getpagesize());
+            }
+            std::fclose(statm);
+        }
+        struct rusage usage = {};
+        if (getrusage(RUSAGE_SELF, &usage) == 0) {
+            memoryUsage.peakRss = std::size_t(usage.ru_maxrss) * 1024;
+            memoryUsage.minorFaults = std::size_t(usage.ru_minflt);
+            memoryUsage.majorFaults = std::size_t(usage.ru_majflt);
+        }
+        return memoryUsage;
+    }
+};
+
+// Statistics of global operator new/delete, available only if allocator.cpp is
+// linked into the target (see common.hpp backends)
+struct AllocationStats
+{
+    std::size_t bytes = 0;  // currently allocated
+    std::size_t peakBytes = 0;
+    std::size_t count = 0;  // currently allocated blocks
+    std::size_t totalCount = 0;
+
+    static AllocationStats current();
+};
+
+struct MappedDeleter
+{
+    std::size_t size;
+
+    void operator()(void * p) const
+    {
+        munmap(p, size);
+    }
+};
+
+template<typename T>
+using MappedPtr = std::unique_ptr<T, MappedDeleter>;
+
+// Zero-filled anonymous mapping of T without reservation of swap space, so
+// huge sparse tables do not need static storage; pages are backed by memory on
+// first touch
+template<typename T>
+MappedPtr<T> mapZeroed()
+{
+    static_assert(std::is_trivially_default_constructible_v<T>);
+    static_assert(std::is_trivially_destructible_v<T>);
+    void * p = mmap(nullptr, sizeof(T), PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) {
+        throw std::bad_alloc{};
+    }
+    return {static_cast<T *>(p), MappedDeleter{sizeof(T)}};
+}
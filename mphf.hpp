@@ -0,0 +1,326 @@
+#pragma once
+
+#include "helpers.hpp"
+#include "oaph.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <cstdint>
+#include <cstring>
+
+// Minimal perfect hash of a known vocabulary (PTHash of Pibiri and Trani):
+// CRC32 of words is mixed and splits them into buckets, which are placed
+// largest first, each by a 16-bit pilot found by search, so that positions of
+// its words are distinct and free. Positions are a little more than words, the
+// ones past the word count are remapped into the free ones below it, thus words
+// map onto [0, wordCount) exactly. Pilots take about 4 bits per word, inline
+// keys and words are stored to verify words out of the vocabulary.
+namespace mphf
+{
+
+constexpr uint32_t kInitialChecksum = 0;
+constexpr uint64_t kBucketSize = 4;  // words per bucket on average
+constexpr uint64_t kLoadFactorPercent = 98;  // of positions before remapping
+constexpr uint32_t kMaxPilot = 0xFFFF;
+constexpr uint64_t kMaxSeedCount = 64;  // of build attempts
+
+// finalizer of MurmurHash3
+inline uint64_t mix(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDu;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53u;
+    x ^= x >> 33;
+    return x;
+}
+
+// x scaled to [0, n) by multiplication rather than division
+inline uint64_t scale(uint64_t x, uint64_t n)
+{
+    return uint64_t((unsigned __int128)x * n >> 64);
+}
+
+inline uint64_t getPosition(uint64_t x, uint32_t pilot, uint64_t positionCount)
+{
+    return scale(mix(x ^ (pilot * 0x9E3779B97F4A7C15u)), positionCount);
+}
+
+// at the beginning of a dictionary, followed by pilots[bucketCount],
+// remap[positionCount - wordCount], keys[wordCount] (16-byte aligned),
+// offsets[wordCount + 1] and NUL-terminated words
+struct Layout
+{
+    uint64_t wordCount;
+    uint64_t positionCount;
+    uint64_t bucketCount;
+    uint64_t seed;
+    uint64_t wordsSize;  // bytes of NUL-terminated words
+};
+
+static_assert(std::is_trivially_copyable_v<Layout>);
+
+// offsets of arrays from the beginning of a dictionary
+struct Sections
+{
+    std::size_t pilots;
+    std::size_t remap;
+    std::size_t keys;
+    std::size_t offsets;
+    std::size_t words;
+    std::size_t size;
+
+    explicit Sections(const Layout & layout)
+    {
+        pilots = sizeof layout;
+        remap = pilots + layout.bucketCount * sizeof(uint16_t);
+        keys = remap + (layout.positionCount - layout.wordCount) *
+                           sizeof(uint32_t);
+        keys = (keys + sizeof(__m128i) - 1) / sizeof(__m128i) *
+               sizeof(__m128i);
+        offsets = keys + layout.wordCount * sizeof(__m128i);
+        words = offsets + (layout.wordCount + 1) * sizeof(uint32_t);
+        size = words + layout.wordsSize;
+    }
+};
+
+// Read-only view of a dictionary made by build(), data should be 16-byte
+// aligned, e.g. mapped from a file
+class Dictionary
+{
+public:
+    explicit Dictionary(const char * data)
+    {
+        std::memcpy(&layout, data, sizeof layout);
+        Sections sections{layout};
+        pilots = reinterpret_cast<const uint16_t *>(data + sections.pilots);
+        remap = reinterpret_cast<const uint32_t *>(data + sections.remap);
+        keys = reinterpret_cast<const __m128i *>(data + sections.keys);
+        offsets = reinterpret_cast<const uint32_t *>(data + sections.offsets);
+        words = data + sections.words;
+    }
+
+    uint64_t size() const
+    {
+        return layout.wordCount;
+    }
+
+    const Layout & getLayout() const
+    {
+        return layout;
+    }
+
+    // the position of a word, size() if it is not in the vocabulary; hash is
+    // CRC32 of the word seeded with kInitialChecksum
+    uint64_t find(uint32_t hash, const char * wordEnd, uint32_t len) const
+    {
+        uint64_t x = mix(hash ^ layout.seed);
+        uint32_t pilot = pilots[scale(x, layout.bucketCount)];
+        uint64_t position = getPosition(x, pilot, layout.positionCount);
+        if UNLIKELY (position >= layout.wordCount) {
+            position = remap[position - layout.wordCount];
+        }
+        const char * word = std::prev(wordEnd, len);
+        if (!oaph::isEqualKey(keys[position], oaph::loadKey(word, len))) {
+            return layout.wordCount;
+        }
+        if ((len >= oaph::kInlineKeySize) &&
+            (getWord(position) != std::string_view{word, len}))
+        {
+            return layout.wordCount;
+        }
+        return position;
+    }
+
+    std::string_view getWord(uint64_t position) const
+    {
+        return {std::next(words, offsets[position]),
+                offsets[position + 1] - offsets[position] - 1};
+    }
+
+private:
+    Layout layout;
+    const uint16_t * pilots;
+    const uint32_t * remap;
+    const __m128i * keys;
+    const uint32_t * offsets;
+    const char * words;
+};
+
+inline uint32_t getHash(std::string_view word)
+{
+    uint32_t hash = kInitialChecksum;
+    for (char c : word) {
+        hash = _mm_crc32_u8(hash, uint8_t(c));
+    }
+    return hash;
+}
+
+// pilots of buckets of hashes mixed with seed, empty if a bucket is not
+// placed by any pilot; positions are marked in taken
+inline std::vector<uint16_t> findPilots(const std::vector<uint32_t> & hashes,
+                                        uint64_t seed, uint64_t bucketCount,
+                                        std::vector<bool> & taken)
+{
+    std::vector<std::pair<uint64_t, uint64_t>> xs;  // (bucket, mixed hash)
+    xs.reserve(hashes.size());
+    for (uint32_t hash : hashes) {
+        uint64_t x = mix(hash ^ seed);
+        xs.emplace_back(scale(x, bucketCount), x);
+    }
+    std::sort(std::begin(xs), std::end(xs));
+    // (size, begin) of buckets in xs, largest first
+    std::vector<std::pair<std::size_t, std::size_t>> buckets;
+    for (std::size_t i = 0; i < xs.size();) {
+        std::size_t j = i;
+        while ((j < xs.size()) && (xs[j].first == xs[i].first)) {
+            ++j;
+        }
+        buckets.emplace_back(j - i, i);
+        i = j;
+    }
+    std::stable_sort(std::begin(buckets), std::end(buckets),
+                     [](const auto & lhs, const auto & rhs) {
+                         return lhs.first > rhs.first;
+                     });
+
+    std::vector<uint16_t> pilots(bucketCount, 0);
+    std::vector<uint64_t> positions;
+    for (const auto & [size, begin] : buckets) {
+        bool placed = false;
+        for (uint32_t pilot = 0; !placed && (pilot <= kMaxPilot); ++pilot) {
+            positions.clear();
+            placed = true;
+            for (std::size_t i = begin; i < begin + size; ++i) {
+                uint64_t position =
+                    getPosition(xs[i].second, pilot, taken.size());
+                if (taken[position]) {
+                    placed = false;
+                    break;
+                }
+                taken[position] = true;  // words of the bucket collide too
+                positions.push_back(position);
+            }
+            if (!placed) {
+                for (uint64_t position : positions) {
+                    taken[position] = false;
+                }
+                continue;
+            }
+            pilots[xs[begin].first] = uint16_t(pilot);
+        }
+        if (!placed) {
+            return {};
+        }
+    }
+    return pilots;
+}
+
+// Dictionary of distinct words, false if no seed places all buckets or words
+// take more than 4 GiB. Words with the hash of a preceding word can't be told
+// apart by the function, they are left out and returned in collisions.
+inline bool build(const std::vector<std::string_view> & vocabulary,
+                  std::vector<char> & dictionary,
+                  std::vector<std::string_view> & collisions)
+{
+    std::vector<std::string_view> words;
+    std::vector<uint32_t> hashes;
+    {
+        std::vector<std::pair<uint32_t, std::size_t>> wordHashes;
+        wordHashes.reserve(vocabulary.size());
+        for (std::size_t i = 0; i < vocabulary.size(); ++i) {
+            wordHashes.emplace_back(getHash(vocabulary[i]), i);
+        }
+        std::sort(std::begin(wordHashes), std::end(wordHashes));
+        for (std::size_t i = 0; i < wordHashes.size(); ++i) {
+            const auto & [hash, word] = wordHashes[i];
+            if ((i != 0) && (wordHashes[i - 1].first == hash)) {
+                collisions.push_back(vocabulary[word]);
+            } else {
+                words.push_back(vocabulary[word]);
+                hashes.push_back(hash);
+            }
+        }
+    }
+
+    Layout layout = {};
+    layout.wordCount = words.size();
+    layout.positionCount = std::max<uint64_t>(
+        (layout.wordCount * 100 + kLoadFactorPercent - 1) / kLoadFactorPercent,
+        1);
+    layout.bucketCount = std::max<uint64_t>(
+        (layout.wordCount + kBucketSize - 1) / kBucketSize, 1);
+    std::vector<uint16_t> pilots;
+    std::vector<bool> taken;
+    for (uint64_t attempt = 0; pilots.empty(); ++attempt) {
+        if (attempt == kMaxSeedCount) {
+            return false;
+        }
+        layout.seed = mix(attempt + 1);
+        taken.assign(layout.positionCount, false);
+        pilots = findPilots(hashes, layout.seed, layout.bucketCount, taken);
+    }
+
+    // taken positions past wordCount go to free ones below it in order
+    std::vector<uint32_t> remap(layout.positionCount - layout.wordCount, 0);
+    uint64_t free = 0;
+    for (uint64_t position = layout.wordCount;
+         position < layout.positionCount; ++position)
+    {
+        if (taken[position]) {
+            while (taken[free]) {
+                ++free;
+            }
+            remap[position - layout.wordCount] = uint32_t(free++);
+        }
+    }
+
+    std::vector<std::string_view> placedWords(layout.wordCount);
+    for (std::size_t i = 0; i < words.size(); ++i) {
+        uint64_t x = mix(hashes[i] ^ layout.seed);
+        uint64_t position = getPosition(
+            x, pilots[scale(x, layout.bucketCount)], layout.positionCount);
+        if (position >= layout.wordCount) {
+            position = remap[position - layout.wordCount];
+        }
+        placedWords[position] = words[i];
+    }
+    for (std::string_view word : placedWords) {
+        layout.wordsSize += word.size() + 1;
+    }
+    if (layout.wordsSize > std::numeric_limits<uint32_t>::max()) {
+        return false;  // offsets are 32-bit
+    }
+
+    Sections sections{layout};
+    dictionary.assign(sections.size, '\0');
+    char * data = dictionary.data();
+    std::memcpy(data, &layout, sizeof layout);
+    std::memcpy(data + sections.pilots, pilots.data(),
+                pilots.size() * sizeof(uint16_t));
+    std::memcpy(data + sections.remap, remap.data(),
+                remap.size() * sizeof(uint32_t));
+    uint32_t offset = 0;
+    for (uint64_t position = 0; position < layout.wordCount; ++position) {
+        std::string_view word = placedWords[position];
+        __m128i key = oaph::loadKey(word.data(), uint32_t(word.size()));
+        std::memcpy(data + sections.keys + position * sizeof key, &key,
+                    sizeof key);
+        std::memcpy(data + sections.offsets + position * sizeof offset,
+                    &offset, sizeof offset);
+        std::copy(std::cbegin(word), std::cend(word), data + sections.words +
+                                                          offset);
+        offset += uint32_t(word.size() + 1);
+    }
+    std::memcpy(data + sections.offsets + layout.wordCount * sizeof offset,
+                &offset, sizeof offset);
+    return true;
+}
+
+}  // namespace mphf
@@ -0,0 +1,192 @@
+#pragma once
+
+#include "helpers.hpp"
+#include "oaph.hpp"
+#include "tokenizer.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <type_traits>
+
+#include <cstdint>
+
+// Word n-grams: a key is CRC32 of hashes of N consecutive words, verified
+// against the tuple of offsets of the words in the output of oaph::HashTable,
+// which is exact, because the hash table stores every word once
+namespace oaph
+{
+
+constexpr auto kNGramTableOrder = 20;
+
+template<std::size_t kN>
+struct NGramTable
+{
+    static_assert(kN >= 2, "use HashTable for words");
+
+    static constexpr uint32_t kMask = (uint32_t(1) << kNGramTableOrder) - 1;
+    static constexpr std::size_t kChunkSize =
+        std::extent_v<decltype(Chunk::count)>;
+    // probing of an almost full table degrades, the rest n-grams are dropped
+    // and counting fails
+    static constexpr std::size_t kMaxSize =
+        (std::size_t(1) << kNGramTableOrder) * kChunkSize / 16 * 15;
+
+    Chunk chunks[1 << kNGramTableOrder];
+    // offsets of words of n-grams, words[i][j][0] is 0 for unused
+    uint32_t words[1 << kNGramTableOrder][kChunkSize][kN];
+    uint64_t spills[1 << kNGramTableOrder][kChunkSize];  // see addCount()
+    std::size_t size;
+
+    void init()
+    {
+        for (Chunk & chunk : chunks) {
+            chunk.hashesHigh = _mm_set1_epi16(int16_t(kDefaultChecksumHigh));
+        }
+        size = 0;
+    }
+
+    // false if the n-gram is new and the table is full
+    bool incCounter(uint32_t hash, const uint32_t (&key)[kN])
+    {
+        uint32_t hashLow = hash & kMask;
+        uint32_t hashHigh = hash >> kNGramTableOrder;
+        for (;;) {
+            Chunk & chunk = chunks[hashLow];
+            __m128i hashesHigh = _mm_load_si128(&chunk.hashesHigh);
+            __m128i mask =
+                _mm_cmpeq_epi16(hashesHigh, _mm_set1_epi16(int16_t(hashHigh)));
+            uint16_t m = uint16_t(_mm_movemask_epi8(mask));
+            unsigned long index;
+            if LIKELY (m != 0) {
+                BSF(index, m);
+                index /= 2;
+                if UNLIKELY (!std::equal(std::cbegin(key), std::cend(key),
+                                         words[hashLow][index]))
+                {
+                    // linear probing
+                    hashLow = (hashLow + 1) & kMask;
+                    continue;
+                }
+            } else {
+                m = uint16_t(_mm_movemask_epi8(hashesHigh)) &
+                    0b1010101010101010u;
+                if UNLIKELY (m == 0) {
+                    // linear probing
+                    hashLow = (hashLow + 1) & kMask;
+                    continue;
+                }
+                if UNLIKELY (size == kMaxSize) {
+                    return false;
+                }
+                ++size;
+                BSF(index, m);
+                index /= 2;
+                reinterpret_cast<uint16_t *>(&chunk.hashesHigh)[index] =
+                    uint16_t(hashHigh);
+                std::copy(std::cbegin(key), std::cend(key),
+                          words[hashLow][index]);
+            }
+            addCount(chunk.count[index], spills[hashLow][index], 1);
+            return true;
+        }
+    }
+
+    // onNGram(count, key) for every counted n-gram
+    template<typename OnNGram>
+    void forEachNGram(OnNGram && onNGram) const
+    {
+        uint32_t hashLow = 0;
+        for (const auto & w : words) {
+            const Chunk & chunk = chunks[hashLow];
+            uint32_t index = 0;
+            for (const auto & key : w) {
+                if (key[0] != 0) {
+                    onNGram(
+                        getCount(chunk.count[index], spills[hashLow][index]),
+                        key);
+                }
+                ++index;
+            }
+            ++hashLow;
+        }
+    }
+};
+
+// Counts words into hashTable and n-grams of consecutive words into
+// nGramTable during the same tokenize() pass, keeping a window of hashes and
+// offsets of the last kN words
+template<std::size_t kN, bool kEnableOpenAddressing, typename CharClass>
+class NGramCounter
+{
+public:
+    using HashTable = oaph::HashTable<kEnableOpenAddressing, CharClass>;
+
+    NGramCounter(HashTable & hashTable, NGramTable<kN> & nGramTable)
+        : hashTable{hashTable}, nGramTable{nGramTable}
+    {}
+
+    // HashTable::countWords() for consecutive blocks
+    void countWords(const char * beg, const char * end, uint32_t & hash,
+                    uint32_t & len)
+    {
+        auto onWord = [this](uint32_t hash, const char * wordEnd,
+                             uint32_t len) { countWord(hash, wordEnd, len); };
+        tokenize<kEnableOpenAddressing, CharClass>(beg, end, kInitialChecksum,
+                                                   hash, len, onWord);
+    }
+
+    // finishes the last word left by countWords()
+    void finish(uint32_t hash, const char * end, uint32_t len)
+    {
+        if (len != 0) {
+            countWord(hash, end, len);
+        }
+    }
+
+    // n-grams which did not fit into nGramTable
+    uint64_t getDropped() const
+    {
+        return dropped;
+    }
+
+private:
+    HashTable & hashTable;
+    NGramTable<kN> & nGramTable;
+    uint32_t hashes[kN] = {};
+    uint32_t offsets[kN] = {};
+    std::size_t windowSize = 0;
+    uint64_t dropped = 0;
+
+    FORCEINLINE void countWord(uint32_t hash, const char * wordEnd,
+                               uint32_t len)
+    {
+        std::copy(std::next(std::cbegin(hashes)), std::cend(hashes),
+                  std::begin(hashes));
+        std::copy(std::next(std::cbegin(offsets)), std::cend(offsets),
+                  std::begin(offsets));
+        hashes[kN - 1] = hash;
+        offsets[kN - 1] = hashTable.incCounter(hash, wordEnd, len);
+        if (windowSize < kN) {
+            if (++windowSize < kN) {
+                return;
+            }
+        }
+        uint32_t nGramHash = kInitialChecksum;
+        for (uint32_t h : hashes) {
+            nGramHash = _mm_crc32_u32(nGramHash, h);
+        }
+        // CRC is linear, so the chain of CRCs of words is a XOR of their
+        // transformed hashes, which clusters; the multiplicative finalizer
+        // of MurmurHash3 breaks the linearity
+        nGramHash ^= nGramHash >> 16;
+        nGramHash *= 0x85EBCA6Bu;
+        nGramHash ^= nGramHash >> 13;
+        nGramHash *= 0xC2B2AE35u;
+        nGramHash ^= nGramHash >> 16;
+        if UNLIKELY (!nGramTable.incCounter(nGramHash, offsets)) {
+            ++dropped;
+        }
+    }
+};
+
+}  // namespace oaph
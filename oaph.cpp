@@ -1,15 +1,30 @@
+#include "affinity.hpp"
+#include "charclass.hpp"
+#include "decompress.hpp"
 #include "helpers.hpp"
 #include "io.hpp"
+#include "ngram.hpp"
+#include "oaph.hpp"
+#include "options.hpp"
+#include "partial.hpp"
+#include "rank.hpp"
+#include "scheduler.hpp"
+#include "snapshot.hpp"
 #include "timer.hpp"
+#include "utf8.hpp"
 
 #include <fmt/color.h>
 #include <fmt/format.h>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
 #include <functional>
 #include <iterator>
 #include <limits>
 #include <memory>
+#include <string>
 #include <string_view>
 #include <tuple>
 #include <type_traits>
@@ -22,6 +37,10 @@
 #include <cstdio>
 #include <cstdlib>
 
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
 namespace
 {
 #if defined(_OPENMP)
@@ -32,132 +51,847 @@ constexpr bool kEnableOpenAddressing = false;  // requires a key comparison
 alignas(__m128i) char input[1 << 29];
 auto inputEnd = input;
 
-// perfect hash seeds: 10675, 98363, 102779, 103674, 105067, 194036, 242662,
-// 290547, 313385, ... seeds 8, 23, 89, 126, 181, 331, 381, 507, ... are also
-// perfect hash seeds, but kHashTableOrder-bit prefix of hash values gives more
-// than 8 collisions per unique one, thus requires an open addressing for
-// hashtable enabled
-constexpr uint32_t kInitialChecksum = 10675;
-constexpr uint16_t kDefaultChecksumHigh = 0xFFFF;
+using oaph::Chunk;
+using oaph::kHashTableOrder;
+
+oaph::HashTable<kEnableOpenAddressing> hashTable;
+// perfect hash seeds do not cover other word definitions and UTF-8 input
+template<typename CharClass>
+oaph::HashTable</* kEnableOpenAddressing */ true, CharClass>
+    verifyingHashTable;
 
-struct alignas(kHardwareDestructiveInterferenceSize) Chunk
+struct Settings
 {
-    __m128i hashesHigh;
-    uint32_t count[sizeof(__m128i) / sizeof(uint16_t)];
+    bool utf8 = false;  // words are runs of UTF-8 letters, case folded
+    std::string_view words;
+    std::string snapshot;  // counts of previous runs are accumulated in it
+    bool partial = false;  // output is a partial result for freq-merge
+    bool shared = false;   // threads count files into a single hashTable
+    Source stream;  // counted while being read, empty to read input at once
+    std::size_t ngram = 1;  // words in phrases counted instead of words
+    std::size_t threadCount = 1;  // of counting a single input
+    std::string stopWords;  // path of words left out of output, if any
+    uint64_t minCount = 1;  // words of lesser counts are left out of output
+    std::vector<int> cpus;  // of worker threads, empty if they are not pinned
+    std::vector<InputFileInfo> inputFiles;  // empty for the single input
 };
 
-static_assert((alignof(Chunk) % alignof(__m128i)) == 0, "!");
+// pins the worker thread to its CPU of settings.cpus, if any, before it
+// touches its memory first
+Placement placeThread(const Settings & settings, std::size_t thread)
+{
+    if (!settings.cpus.empty() &&
+        !pinThread(settings.cpus[thread % settings.cpus.size()]))
+    {
+        fmt::print(stderr, "failed to pin thread {}\n", thread);
+    }
+    return getPlacement();
+}
 
-constexpr auto kHashTableOrder =
-    std::numeric_limits<uint16_t>::digits +
-    1;  // one bit window to distinct kDefaultChecksumHigh
-constexpr uint32_t kHashTableMask = (uint32_t(1) << kHashTableOrder) - 1;
-Chunk hashTable[1 << kHashTableOrder];
+void reportPlacements(const std::vector<Placement> & placements,
+                      const Settings & settings)
+{
+    for (std::size_t thread = 0; thread < placements.size(); ++thread) {
+        fmt::print(stderr, "thread {} on cpu {} node {}{}\n", thread,
+                   placements[thread].cpu, placements[thread].node,
+                   settings.cpus.empty() ? " (not pinned)" : "");
+    }
+}
 
-alignas(__m128i) char output[1 << 22] = {};
-auto o = std::next(output);  // words[i][j] == std::distance(output, o) is 0 for
-                             // unused hashes only
-uint32_t words[std::extent_v<decltype(hashTable)>]
-              [std::extent_v<decltype(Chunk::count)>] = {};
+// makes [beg, end) suitable for HashTable::countWords(), returns false for
+// invalid UTF-8
+template<bool kEnableOpenAddressing, typename CharClass>
+bool prepareInput(char * beg, char * end, const Settings & settings)
+{
+    if (settings.utf8) {
+        return foldUtf8(beg, end);
+    } else if (kEnableOpenAddressing) {
+        toLower<CharClass>(beg, end);
+    }
+    return true;
+}
 
-void incCounter(uint32_t hash, const char * __restrict wordEnd, uint32_t len)
+// Files are counted into per-thread tables, largest first, then the tables
+// are merged into hashTable; or directly into hashTable if settings.shared
+template<bool kEnableOpenAddressing, typename CharClass>
+bool countFiles(oaph::HashTable<kEnableOpenAddressing, CharClass> & hashTable,
+                const Settings & settings, Timer & timer)
 {
-    uint32_t hashLow = hash & kHashTableMask;
-    uint32_t hashHigh = hash >> kHashTableOrder;
-    for (;;) {
-        Chunk & chunk = hashTable[hashLow];
-        __m128i hashesHigh = _mm_load_si128(&chunk.hashesHigh);
-        __m128i mask =
-            _mm_cmpeq_epi16(hashesHigh, _mm_set1_epi16(int16_t(hashHigh)));
-        uint16_t m = uint16_t(_mm_movemask_epi8(mask));
-        unsigned long index;
-        if LIKELY (m != 0) {
-            BSF(index, m);
-            index /= 2;
-            if (kEnableOpenAddressing &&
-                UNLIKELY(!std::equal(std::prev(wordEnd, len),
-                                     std::next(wordEnd),
-                                     std::next(output, words[hashLow][index]))))
+    using HashTable = oaph::HashTable<kEnableOpenAddressing, CharClass>;
+    const auto & files = settings.inputFiles;
+    std::size_t threadCount = 1;
+#if defined(_OPENMP)
+    threadCount = std::size_t(omp_get_max_threads());
+#endif
+    threadCount = std::min(threadCount, files.size());
+    if constexpr (kEnableOpenAddressing) {
+        if (settings.shared) {
+            std::atomic<bool> success = true;
+            std::vector<Placement> placements(threadCount);
+#pragma omp parallel num_threads(int(threadCount))
             {
-                hashLow = (hashLow + 1) & kHashTableMask;  // linear probing
-                continue;
+                std::size_t thread = 0;
+#if defined(_OPENMP)
+                thread = std::size_t(omp_get_thread_num());
+#endif
+                placements[thread] = placeThread(settings, thread);
+                InputBuffer inputBuffer;
+#pragma omp for schedule(dynamic, 1)
+                for (int64_t i = 0; i < int64_t(files.size()); ++i) {
+                    const auto & path = files[std::size_t(i)].path;
+                    if (!inputBuffer.read(path)) {
+                        fmt::print(stderr, "failed to read '{}'\n", path);
+                        success = false;
+                        continue;
+                    }
+                    if (!prepareInput<kEnableOpenAddressing, CharClass>(
+                            inputBuffer.begin(), inputBuffer.end(), settings))
+                    {
+                        fmt::print(stderr,
+                                   "'{}' is not valid UTF-8, invalid sequences "
+                                   "are treated as separators\n",
+                                   path);
+                    }
+                    hashTable.countWordsShared(inputBuffer.begin(),
+                                               inputBuffer.end());
+                }
             }
-        } else {
-            m = uint16_t(_mm_movemask_epi8(hashesHigh)) & 0b1010101010101010u;
-            if (kEnableOpenAddressing && UNLIKELY(m == 0)) {
-                hashLow = (hashLow + 1) & kHashTableMask;  // linear probing
+            fmt::print(stderr, "{} threads, shared hashTable\n", threadCount);
+            reportPlacements(placements, settings);
+            timer.report(fmt::format(fg(fmt::color::dark_blue), "count words"));
+            return success;
+        }
+    }
+    std::vector<MappedPtr<HashTable>> threadHashTables;
+    threadHashTables.reserve(threadCount);
+    for (std::size_t thread = 0; thread < threadCount; ++thread) {
+        threadHashTables.push_back(mapZeroed<HashTable>());
+    }
+
+    std::atomic<bool> success = true;
+    std::vector<Placement> placements(threadCount);
+#pragma omp parallel num_threads(int(threadCount))
+    {
+        std::size_t thread = 0;
+#if defined(_OPENMP)
+        thread = std::size_t(omp_get_thread_num());
+#endif
+        placements[thread] = placeThread(settings, thread);
+        HashTable & threadHashTable = *threadHashTables[thread];
+        threadHashTable.init();
+        InputBuffer inputBuffer;
+#pragma omp for schedule(dynamic, 1)
+        for (int64_t i = 0; i < int64_t(files.size()); ++i) {
+            const auto & path = files[std::size_t(i)].path;
+            if (!inputBuffer.read(path)) {
+                fmt::print(stderr, "failed to read '{}'\n", path);
+                success = false;
                 continue;
             }
-            BSF(index, m);
-            index /= 2;
-            reinterpret_cast<uint16_t *>(&chunk.hashesHigh)[index] = hashHigh;
-            words[hashLow][index] = uint32_t(std::distance(output, o));
-            o = std::next(std::copy_n(std::prev(wordEnd, len), len, o));
+            if (!prepareInput<kEnableOpenAddressing, CharClass>(
+                    inputBuffer.begin(), inputBuffer.end(), settings))
+            {
+                fmt::print(stderr,
+                           "'{}' is not valid UTF-8, invalid sequences are "
+                           "treated as separators\n",
+                           path);
+            }
+            threadHashTable.countWords(inputBuffer.begin(), inputBuffer.end());
         }
-        ++chunk.count[index];
-        return;
+        if (!settings.utf8) {
+            threadHashTable.arena.template toLower<CharClass>();
+        }
+    }
+    fmt::print(stderr, "{} threads\n", threadCount);
+    reportPlacements(placements, settings);
+    timer.report(fmt::format(fg(fmt::color::dark_blue), "count words"));
+    if (!success) {
+        return false;
     }
+
+    for (const auto & threadHashTable : threadHashTables) {
+        hashTable.merge(*threadHashTable);
+        threadHashTable->arena.release();
+    }
+    timer.report("merge thread hashTables");
+    return true;
 }
 
-void countWords()
+// Blocks are counted while the next one is being read, a word straddling
+// blocks is continued by the next one
+template<bool kEnableOpenAddressing, typename CharClass>
+bool countStream(oaph::HashTable<kEnableOpenAddressing, CharClass> & hashTable,
+                 const Source & source, Timer & timer)
 {
-    uint32_t hash = kInitialChecksum;
+    assert(!charclass::kHasInner<CharClass>);
+    auto start = std::chrono::steady_clock::now();
+    AsyncReader reader{source};
+    uint32_t hash = oaph::kInitialChecksum;
     uint32_t len = 0;
-    for (auto i = input; LIKELY(i < inputEnd); i += sizeof(__m128i)) {
-        __m128i str = _mm_load_si128(reinterpret_cast<const __m128i *>(i));
-        __m128i mask;
+    while (reader.next(len)) {
         if (kEnableOpenAddressing) {
-            mask = _mm_cmpeq_epi8(str, _mm_setzero_si128());
+            toLower<CharClass>(reader.begin(), reader.end());
+        }
+        hashTable.countWords(reader.begin(), reader.end(), hash, len);
+    }
+    if (reader.isFailed()) {
+        return false;
+    }
+    assert(len == 0);  // the last block ends with NUL
+    std::chrono::duration<double> time =
+        std::chrono::steady_clock::now() - start;
+    double inputSize = double(reader.getReadSize());
+    constexpr double kMiB = 1 << 20;
+    fmt::print(stderr, "input size = {} bytes\n", reader.getReadSize());
+    // reading includes decompression
+    fmt::print(stderr, "read {:.1f} MiB/s, count {:.1f} MiB/s\n",
+               inputSize / kMiB / reader.getReadTime(),
+               inputSize / kMiB / (time.count() - reader.getWaitTime()));
+    timer.report(fmt::format(fg(fmt::color::dark_blue), "count words"));
+    return true;
+}
+
+constexpr std::size_t kTaskSize = 1 << 18;
+
+// input is split into tasks of kTaskSize bytes balanced by work stealing,
+// which are counted into per-thread tables merged into hashTable then; or
+// directly into hashTable if settings.shared
+template<bool kEnableOpenAddressing, typename CharClass>
+void countInput(oaph::HashTable<kEnableOpenAddressing, CharClass> & hashTable,
+                std::size_t threadCount, const Settings & settings,
+                Timer & timer)
+{
+    using HashTable = oaph::HashTable<kEnableOpenAddressing, CharClass>;
+    auto inputSize = std::size_t(std::distance(input, inputEnd));
+    auto taskCount = uint32_t((inputSize + kTaskSize - 1) / kTaskSize);
+    threadCount = std::min(threadCount, std::size_t(taskCount));
+    bool shared = kEnableOpenAddressing && settings.shared;
+    std::vector<MappedPtr<HashTable>> threadHashTables;
+    if (!shared) {
+        threadHashTables.reserve(threadCount);
+        for (std::size_t thread = 0; thread < threadCount; ++thread) {
+            threadHashTables.push_back(mapZeroed<HashTable>());
+        }
+    }
+
+    WorkStealingScheduler scheduler{threadCount, taskCount};
+    std::vector<double> busyTimes(threadCount);
+    std::vector<uint32_t> taskCounts(threadCount);
+    std::vector<Placement> placements(threadCount);
+#pragma omp parallel num_threads(int(threadCount))
+    {
+        std::size_t thread = 0;
+#if defined(_OPENMP)
+        thread = std::size_t(omp_get_thread_num());
+#endif
+        placements[thread] = placeThread(settings, thread);
+        HashTable * threadHashTable = nullptr;
+        if (!shared) {
+            threadHashTable = threadHashTables[thread].get();
+            threadHashTable->init();
+        }
+        Timer busyTimer{fmt::format("thread {}", thread)};
+        double busyTime = 0.0;
+        uint32_t threadTaskCount = 0;
+        uint32_t task = 0;
+        while (scheduler.next(thread, task)) {
+            busyTimer.dt();
+            auto beg = std::next(input, std::ptrdiff_t(task * kTaskSize));
+            auto end =
+                std::next(beg, std::ptrdiff_t(std::min(
+                                   kTaskSize, inputSize - task * kTaskSize)));
+            if constexpr (kEnableOpenAddressing) {
+                if (shared) {
+                    hashTable.countTaskWordsShared(input, beg, end, inputEnd);
+                } else {
+                    threadHashTable->countTaskWords(input, beg, end, inputEnd);
+                }
+            } else {
+                threadHashTable->countTaskWords(input, beg, end, inputEnd);
+            }
+            busyTime += busyTimer.dt();
+            ++threadTaskCount;
+        }
+        if (!shared && !settings.utf8) {
+            threadHashTable->arena.template toLower<CharClass>();
+        }
+        busyTimes[thread] = busyTime;
+        taskCounts[thread] = threadTaskCount;
+    }
+    fmt::print(stderr, "{} threads, {} tasks, {} steals{}\n", threadCount,
+               taskCount, scheduler.getSteals(),
+               shared ? ", shared hashTable" : "");
+    for (std::size_t thread = 0; thread < threadCount; ++thread) {
+        fmt::print(stderr, "time (thread {} busy) = {:.3}, {} tasks\n", thread,
+                   busyTimes[thread], taskCounts[thread]);
+    }
+    reportPlacements(placements, settings);
+    timer.report(fmt::format(fg(fmt::color::dark_blue), "count words"));
+
+    for (const auto & threadHashTable : threadHashTables) {
+        hashTable.merge(*threadHashTable);
+        threadHashTable->arena.release();
+    }
+    if (!shared) {
+        timer.report("merge thread hashTables");
+    }
+}
+
+// the pages of the tasks a thread of countInput() starts with are touched by
+// it first, before input is read into them
+void placeInput(std::size_t inputSize, const Settings & settings)
+{
+    auto taskCount = (inputSize + kTaskSize - 1) / kTaskSize;
+    if (taskCount == 0) {
+        return;
+    }
+    std::size_t threadCount = std::min(settings.threadCount, taskCount);
+#pragma omp parallel num_threads(int(threadCount))
+    {
+        std::size_t thread = 0;
+#if defined(_OPENMP)
+        thread = std::size_t(omp_get_thread_num());
+#endif
+        placeThread(settings, thread);
+        auto beg = taskCount * thread / threadCount * kTaskSize;
+        auto end = std::min(taskCount * (thread + 1) / threadCount * kTaskSize,
+                            inputSize);
+        touchPages(std::next(input, std::ptrdiff_t(beg)),
+                   std::next(input, std::ptrdiff_t(end)));
+    }
+}
+
+// parts of the table shared by threads are touched by each of them first, so
+// that the table is spread over their nodes rather than placed on one
+template<bool kEnableOpenAddressing, typename CharClass>
+void placeTable(oaph::HashTable<kEnableOpenAddressing, CharClass> & hashTable,
+                const Settings & settings)
+{
+    std::size_t threadCount = settings.cpus.size();
+#pragma omp parallel num_threads(int(threadCount))
+    {
+        std::size_t thread = 0;
+#if defined(_OPENMP)
+        thread = std::size_t(omp_get_thread_num());
+#endif
+        placeThread(settings, thread);
+        auto touch = [thread, threadCount](auto & array) {
+            auto beg = reinterpret_cast<char *>(&array);
+            touchPages(beg, std::next(beg, sizeof array), thread, threadCount);
+        };
+        touch(hashTable.chunks);
+        touch(hashTable.words);
+        touch(hashTable.keys);
+    }
+}
+
+// Words and their kN-grams are counted during a single pass over the input,
+// then kN-grams are output
+template<std::size_t kN, bool kEnableOpenAddressing, typename CharClass>
+int countNGrams(oaph::HashTable<kEnableOpenAddressing, CharClass> & hashTable,
+                const Settings & settings, const File & outputFile,
+                Timer & timer)
+{
+    auto nGramTable = mapZeroed<oaph::NGramTable<kN>>();
+    nGramTable->init();
+    timer.report("init nGramTable");
+
+    oaph::NGramCounter<kN, kEnableOpenAddressing, CharClass> nGramCounter{
+        hashTable, *nGramTable};
+    uint32_t hash = oaph::kInitialChecksum;
+    uint32_t len = 0;
+    std::size_t inputSize = 0;
+    auto start = std::chrono::steady_clock::now();
+    if (settings.stream) {
+        AsyncReader reader{settings.stream};
+        while (reader.next(len)) {
+            if (kEnableOpenAddressing) {
+                toLower<CharClass>(reader.begin(), reader.end());
+            }
+            nGramCounter.countWords(reader.begin(), reader.end(), hash, len);
+        }
+        if (reader.isFailed()) {
+            return EXIT_FAILURE;
+        }
+        inputSize = reader.getReadSize();
+    } else {
+        if (!prepareInput<kEnableOpenAddressing, CharClass>(input, inputEnd,
+                                                            settings))
+        {
+            fmt::print(stderr,
+                       "input is not valid UTF-8, invalid sequences are "
+                       "treated as separators\n");
+        }
+        nGramCounter.countWords(input, inputEnd, hash, len);
+        nGramCounter.finish(hash, inputEnd, len);
+        inputSize = std::size_t(std::distance(input, inputEnd));
+    }
+    std::chrono::duration<double> time =
+        std::chrono::steady_clock::now() - start;
+    constexpr double kMiB = 1 << 20;
+    fmt::print(stderr, "{}-grams: {} unique, {:.1f} MiB/s\n", kN,
+               nGramTable->size, double(inputSize) / kMiB / time.count());
+    timer.report(fmt::format(fg(fmt::color::dark_blue), "count words"));
+    if (nGramCounter.getDropped() != 0) {
+        fmt::print(stderr,
+                   "nGramTable is full: {} n-grams did not fit, more than {} "
+                   "unique ones are not supported\n",
+                   nGramCounter.getDropped(), oaph::NGramTable<kN>::kMaxSize);
+        return EXIT_FAILURE;
+    }
+    if (hashTable.arena.isFull()) {
+        fmt::print(stderr, "word arena is full\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!settings.utf8) {
+        hashTable.arena.template toLower<CharClass>();
+        timer.report("make output lowercase");
+    }
+
+    std::vector<std::pair<uint64_t, const uint32_t *>> rank;
+    rank.reserve(nGramTable->size);
+    nGramTable->forEachNGram(
+        [&rank, &settings](uint64_t count, const uint32_t(&key)[kN]) {
+            if (count >= settings.minCount) {
+                rank.emplace_back(count, key);
+            }
+        });
+    timer.report("collect n-gram counts");
+
+    // words are compared one by one, which is the order of n-grams as strings
+    auto wordLess = [&hashTable](uint32_t lhs, uint32_t rhs) {
+        return hashTable.arena.getWord(lhs) < hashTable.arena.getWord(rhs);
+    };
+    std::sort(std::begin(rank), std::end(rank),
+              [&wordLess](const auto & lhs, const auto & rhs) {
+                  if (lhs.first != rhs.first) {
+                      return rhs.first < lhs.first;
+                  }
+                  return std::lexicographical_compare(
+                      lhs.second, std::next(lhs.second, kN), rhs.second,
+                      std::next(rhs.second, kN), wordLess);
+              });
+    timer.report(fmt::format(fg(fmt::color::dark_orange), "sort n-grams"));
+
+    OutputStream<> outputStream{outputFile};
+    for (const auto & [count, key] : rank) {
+        bool success = outputStream.print(count);
+        for (std::size_t i = 0; i < kN; ++i) {
+            success = success && outputStream.putChar(' ') &&
+                      outputStream.print(hashTable.arena.getWord(key[i]));
+        }
+        if (!success || !outputStream.putChar('\n')) {
+            fmt::print(stderr, "output failure\n");
+            return EXIT_FAILURE;
+        }
+    }
+    timer.report("write output");
+
+    return EXIT_SUCCESS;
+}
+
+// reports arena usage and makes words lowercase, false if arena is full
+template<bool kEnableOpenAddressing, typename CharClass>
+bool finishCounting(
+    oaph::HashTable<kEnableOpenAddressing, CharClass> & hashTable,
+    const Settings & settings, Timer & timer)
+{
+    if (hashTable.arena.isFull()) {
+        fmt::print(stderr, "word arena is full\n");
+        return false;
+    }
+    fmt::print(stderr, "word arena = {} bytes\n", hashTable.arena.getSize());
+
+    if (!settings.utf8) {
+        hashTable.arena.template toLower<CharClass>();
+        timer.report("make output lowercase");
+    }
+    return true;
+}
+
+// sorted references of the words of settings.stopWords counted in hashTable,
+// which should be made lowercase; the file is split into words the way input
+// is, so they are looked up once instead of being checked for every word
+template<bool kEnableOpenAddressing, typename CharClass>
+bool findStopWords(
+    const oaph::HashTable<kEnableOpenAddressing, CharClass> & hashTable,
+    const Settings & settings, std::vector<uint32_t> & stopWords)
+{
+    InputBuffer inputBuffer;
+    if (!inputBuffer.read(settings.stopWords)) {
+        fmt::print(stderr, "failed to read '{}' file\n", settings.stopWords);
+        return false;
+    }
+    if (settings.utf8) {
+        foldUtf8(inputBuffer.begin(), inputBuffer.end());
+    } else {
+        toLower<CharClass>(inputBuffer.begin(), inputBuffer.end());
+    }
+    uint32_t hash = oaph::kInitialChecksum;
+    uint32_t len = 0;
+    auto onWord = [&](uint32_t hash, const char * wordEnd, uint32_t len) {
+        uint32_t word = hashTable.findWord(hash, wordEnd, len);
+        if (word != 0) {
+            stopWords.push_back(word);
+        }
+    };
+    // NUL padding ends the last word
+    tokenize</* kInputIsLowercase */ true>(inputBuffer.begin(),
+                                           inputBuffer.end(),
+                                           oaph::kInitialChecksum, hash, len,
+                                           onWord);
+    std::sort(std::begin(stopWords), std::end(stopWords));
+    return true;
+}
+
+// ranked words of hashTable, or sorted ones for freq-merge; stop words and
+// words below settings.minCount are dropped while being collected, so they
+// are neither sorted nor written
+template<bool kEnableOpenAddressing, typename CharClass>
+int writeCounts(
+    const oaph::HashTable<kEnableOpenAddressing, CharClass> & hashTable,
+    const Settings & settings, const File & outputFile, Timer & timer)
+{
+    std::vector<uint32_t> stopWords;
+    if (!settings.stopWords.empty()) {
+        if (!findStopWords(hashTable, settings, stopWords)) {
+            return EXIT_FAILURE;
+        }
+        timer.report("find stop words");
+    }
+
+    std::vector<PrefixRankEntry<uint32_t>> rank;
+    rank.reserve(std::extent_v<decltype(hashTable.words)> *
+                 std::extent_v<decltype(hashTable.words), 1>);
+    std::size_t wordCount = 0;
+    hashTable.forEachWord([&](uint64_t count, uint32_t word) {
+        ++wordCount;
+        if ((count < settings.minCount) ||
+            (!stopWords.empty() &&
+             std::binary_search(std::cbegin(stopWords), std::cend(stopWords),
+                                word)))
+        {
+            return;
+        }
+        rank.push_back(
+            {getWordPrefix(hashTable.arena.getWord(word)), count, word});
+    });
+    fmt::print(stderr, "load factor = {:.3}\n",
+               double(wordCount) / double(rank.capacity()));
+    if (rank.size() != wordCount) {
+        fmt::print(stderr, "{} of {} words dropped\n", wordCount - rank.size(),
+                   wordCount);
+    }
+    timer.report("collect word counts");
+
+    auto wordLess = [&hashTable](uint32_t lhs, uint32_t rhs) {
+        return hashTable.arena.getWord(lhs) < hashTable.arena.getWord(rhs);
+    };
+
+    if (settings.partial) {
+        std::sort(std::begin(rank), std::end(rank),
+                  [&wordLess](const auto & lhs, const auto & rhs) {
+                      if (lhs.prefix != rhs.prefix) {
+                          return lhs.prefix < rhs.prefix;
+                      }
+                      return wordLess(lhs.word, rhs.word);
+                  });
+        timer.report(fmt::format(fg(fmt::color::dark_orange), "sort words"));
+
+        PartialWriter<> partialWriter{outputFile,
+                                      settings.utf8 ? "utf8" : settings.words};
+        for (const auto & [prefix, count, word] : rank) {
+            if (!partialWriter.write(hashTable.arena.getWord(word), count)) {
+                fmt::print(stderr, "output failure\n");
+                return EXIT_FAILURE;
+            }
+        }
+        if (!partialWriter.finish()) {
+            fmt::print(stderr, "output failure\n");
+            return EXIT_FAILURE;
+        }
+        timer.report("write output");
+        return EXIT_SUCCESS;
+    }
+
+    std::sort(std::begin(rank), std::end(rank), PrefixRankLess{wordLess});
+    timer.report(fmt::format(fg(fmt::color::dark_orange), "sort words"));
+
+    OutputStream<> outputStream{outputFile};
+    for (const auto & [prefix, count, word] : rank) {
+        if (!outputStream.print(count)) {
+            fmt::print(stderr, "output failure\n");
+            return EXIT_FAILURE;
+        }
+        if (!outputStream.putChar(' ')) {
+            fmt::print(stderr, "output failure\n");
+            return EXIT_FAILURE;
+        }
+        if (!outputStream.print(hashTable.arena.getWord(word))) {
+            fmt::print(stderr, "output failure\n");
+            return EXIT_FAILURE;
+        }
+        if (!outputStream.putChar('\n')) {
+            fmt::print(stderr, "output failure\n");
+            return EXIT_FAILURE;
+        }
+    }
+    timer.report("write output");
+
+    return EXIT_SUCCESS;
+}
+
+template<bool kEnableOpenAddressing, typename CharClass>
+int countWords(
+    oaph::HashTable<kEnableOpenAddressing, CharClass> & staticHashTable,
+    const Settings & settings, const File & outputFile, Timer & timer)
+{
+    using HashTable = oaph::HashTable<kEnableOpenAddressing, CharClass>;
+    MappedPtr<SnapshotImage<HashTable>> snapshot{nullptr, MappedDeleter{0}};
+    bool created = true;
+    if (!settings.snapshot.empty()) {
+        auto header = makeSnapshotHeader(
+            "oaph", settings.utf8 ? "utf8" : settings.words,
+            oaph::kInitialChecksum, kHashTableOrder, kEnableOpenAddressing,
+            sizeof(HashTable));
+        snapshot =
+            mapSnapshot<HashTable>(settings.snapshot, header, created);
+        if (!snapshot) {
+            return EXIT_FAILURE;
+        }
+    }
+    HashTable & hashTable = snapshot ? snapshot->value : staticHashTable;
+    if (created) {
+        // pages of a snapshot are placed by the page cache
+        if (!snapshot && settings.shared && !settings.cpus.empty()) {
+            placeTable(hashTable, settings);
+        }
+        hashTable.init();
+        timer.report("init hashTable");
+    } else {
+        auto readArena = [&hashTable](std::FILE * file) {
+            return hashTable.arena.read(file);
+        };
+        if (!readSnapshotTail<HashTable>(settings.snapshot, readArena)) {
+            fmt::print(stderr, "failed to read snapshot '{}'\n",
+                       settings.snapshot);
+            return EXIT_FAILURE;
+        }
+        if (snapshot->header.used != hashTable.arena.getSize()) {
+            fmt::print(stderr,
+                       "snapshot '{}' is corrupted: word arena size "
+                       "mismatch\n",
+                       settings.snapshot);
+            return EXIT_FAILURE;
+        }
+        timer.report("map snapshot");
+    }
+
+    switch (settings.ngram) {
+    case 2:
+        return countNGrams<2>(hashTable, settings, outputFile, timer);
+    case 3:
+        return countNGrams<3>(hashTable, settings, outputFile, timer);
+    case 4:
+        return countNGrams<4>(hashTable, settings, outputFile, timer);
+    }
+
+    // a directory without files is counted like empty input, so that an
+    // empty result is written, which freq-merge expects of --partial
+    if (!settings.inputFiles.empty()) {
+        if (!countFiles(hashTable, settings, timer)) {
+            return EXIT_FAILURE;
+        }
+    } else if (settings.stream) {
+        if (!countStream(hashTable, settings.stream, timer)) {
+            return EXIT_FAILURE;
+        }
+    } else {
+        if (!prepareInput<kEnableOpenAddressing, CharClass>(input, inputEnd,
+                                                            settings))
+        {
+            fmt::print(stderr,
+                       "input is not valid UTF-8, invalid sequences are "
+                       "treated as separators\n");
+        }
+        if (settings.utf8) {
+            timer.report("fold input case");
+        } else if (kEnableOpenAddressing) {
+            timer.report("make input lowercase");
+        }
+
+        std::size_t threadCount = 1;
+#if defined(_OPENMP)
+        threadCount = settings.threadCount;
+#endif
+        if ((threadCount > 1) && (inputEnd != input)) {
+            countInput(hashTable, threadCount, settings, timer);
         } else {
-            str = _mm_add_epi8(
-                _mm_and_si128(_mm_cmplt_epi8(str, _mm_set1_epi8('a')),
-                              _mm_set1_epi8('a' - 'A')),
-                str);
-            mask = _mm_or_si128(_mm_cmplt_epi8(str, _mm_set1_epi8('a')),
-                                _mm_cmpgt_epi8(str, _mm_set1_epi8('z')));
-        }
-        uint16_t m = uint16_t(_mm_movemask_epi8(mask));
-        // clang-format off
-#define BYTE(offset)                                                           \
-        if UNPREDICTABLE ((m & (uint32_t(1) << offset)) == 0) {                \
-            ++len;                                                             \
-            hash = _mm_crc32_u8(hash, uint8_t(_mm_extract_epi8(str, offset))); \
-        } else if UNPREDICTABLE (len != 0) {                                   \
-            incCounter(hash, std::next(i, offset), len);                       \
-            len = 0;                                                           \
-            hash = kInitialChecksum;                                           \
-        }
-
-        BYTE(0)
-        BYTE(1)
-        BYTE(2)
-        BYTE(3)
-        BYTE(4)
-        BYTE(5)
-        BYTE(6)
-        BYTE(7)
-        BYTE(8)
-        BYTE(9)
-        BYTE(10)
-        BYTE(11)
-        BYTE(12)
-        BYTE(13)
-        BYTE(14)
-        BYTE(15)
-#undef BYTE
-        // clang-format on
-    }
-    if (len != 0) {
-        incCounter(hash, inputEnd, len);
+            if (!settings.cpus.empty()) {
+                reportPlacements({placeThread(settings, 0)}, settings);
+            }
+            hashTable.countWords(input, inputEnd);
+            timer.report(
+                fmt::format(fg(fmt::color::dark_blue), "count words"));
+        }
+    }
+
+    if (!finishCounting(hashTable, settings, timer)) {
+        return EXIT_FAILURE;
+    }
+
+    if (snapshot) {
+        snapshot->header.used = hashTable.arena.getSize();
+        auto writeArena = [&hashTable](std::FILE * file) {
+            return hashTable.arena.write(file);
+        };
+        if (!writeSnapshotImage<HashTable>(settings.snapshot, snapshot,
+                                           writeArena))
+        {
+            return EXIT_FAILURE;
+        }
+        timer.report("write snapshot");
     }
+
+    return writeCounts(hashTable, settings, outputFile, timer);
+}
+
+// a job of countBatch(), hashTable is reset afterwards
+template<bool kEnableOpenAddressing, typename CharClass>
+bool countJob(oaph::HashTable<kEnableOpenAddressing, CharClass> & hashTable,
+              const Settings & settings, const std::string & inputPath,
+              const std::string & outputPath)
+{
+    Timer timer{fmt::format(fg(fmt::color::dark_green), "job")};
+
+    auto inputFile = openFile(inputPath.c_str(), "rb");
+    if (!inputFile) {
+        fmt::print(stderr, "failed to open '{}' file to read\n", inputPath);
+        return false;
+    }
+    Compression compression = Compression::kNone;
+    Source source = openSource(inputFile, compression);
+    if (!source) {
+        return false;
+    }
+    auto outputFile = (outputPath == "-")
+                          ? wrapFile(stdout)
+                          : openFile(outputPath.c_str(), "wb");
+    if (!outputFile) {
+        fmt::print(stderr, "failed to open '{}' file to write\n", outputPath);
+        return false;
+    }
+
+    std::ptrdiff_t readSize =
+        readInput(std::begin(input), std::size(input), source);
+    if (readSize < 0) {
+        return false;
+    }
+    // empty input is counted too, to write an empty result
+    inputEnd = std::next(input, readSize);
+    // bytes of the previous job would continue the last word
+    auto tailSize = std::min<std::ptrdiff_t>(
+        sizeof(__m128i), std::distance(inputEnd, std::end(input)));
+    std::fill_n(inputEnd, tailSize, '\0');
+    timer.report("read input");
+
+    if (!prepareInput<kEnableOpenAddressing, CharClass>(input, inputEnd,
+                                                        settings))
+    {
+        fmt::print(stderr,
+                   "input is not valid UTF-8, invalid sequences are treated "
+                   "as separators\n");
+    }
+    hashTable.countWords(input, inputEnd);
+    timer.report(fmt::format(fg(fmt::color::dark_blue), "count words"));
+
+    bool success = finishCounting(hashTable, settings, timer) &&
+                   (writeCounts(hashTable, settings, outputFile, timer) ==
+                    EXIT_SUCCESS);
+    hashTable.reset();
+    timer.report("reset hashTable");
+    return success;
+}
+
+// Jobs of requestsFile, a line "in.txt out.txt" each, are counted one after
+// another by a single thread into hashTable, which is initialized once and
+// then reset in time proportional to the number of words of a job; a line
+// "ok out.txt" or "failed out.txt" is printed to stdout once a job is done
+template<bool kEnableOpenAddressing, typename CharClass>
+int countBatch(oaph::HashTable<kEnableOpenAddressing, CharClass> & hashTable,
+               const Settings & settings, const File & requestsFile,
+               Timer & timer)
+{
+    hashTable.init();
+    timer.report("init hashTable");
+
+    std::size_t jobCount = 0;
+    std::size_t failedJobCount = 0;
+    char * line = nullptr;
+    std::size_t lineCapacity = 0;
+    for (;;) {
+        auto lineSize = getline(&line, &lineCapacity, requestsFile.get());
+        if (lineSize < 0) {
+            break;
+        }
+        constexpr std::string_view kSpaces = " \t\r\n";
+        std::string_view request{line, std::size_t(lineSize)};
+        request.remove_suffix(request.size() -
+                              (request.find_last_not_of(kSpaces) + 1));
+        request.remove_prefix(
+            std::min(request.find_first_not_of(kSpaces), request.size()));
+        if (request.empty()) {
+            continue;
+        }
+        ++jobCount;
+        auto separator = request.find_first_of(kSpaces);
+        auto outputPathPos = request.find_first_not_of(kSpaces, separator);
+        if (outputPathPos == std::string_view::npos) {
+            fmt::print(stderr, "request '{}' is not 'in.txt out.txt'\n",
+                       request);
+            ++failedJobCount;
+            fmt::print("failed {}\n", request);
+        } else {
+            std::string inputPath{request.substr(0, separator)};
+            std::string outputPath{request.substr(outputPathPos)};
+            bool success =
+                countJob(hashTable, settings, inputPath, outputPath);
+            if (!success) {
+                ++failedJobCount;
+            }
+            fmt::print("{} {}\n", success ? "ok" : "failed", outputPath);
+        }
+        std::fflush(stdout);
+    }
+    std::free(line);
+    fmt::print(stderr, "{} jobs, {} failed\n", jobCount, failedJobCount);
+    return (failedJobCount == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// onHashTable(hashTable) with the table of settings
+template<typename OnHashTable>
+int withHashTable(const Settings & settings, OnHashTable && onHashTable)
+{
+    using namespace std::string_view_literals;
+    const auto & words = settings.words;
+    // concurrent insertion into the shared table requires a key comparison
+    if (settings.utf8 || (settings.shared && (words == "alpha"sv))) {
+        return onHashTable(verifyingHashTable<charclass::Alpha>);
+    } else if (words == "alpha"sv) {
+        return onHashTable(hashTable);
+    } else if (words == "alnum"sv) {
+        return onHashTable(verifyingHashTable<charclass::Alnum>);
+    } else if (words == "identifier"sv) {
+        return onHashTable(verifyingHashTable<charclass::Identifier>);
+    }
+    return onHashTable(verifyingHashTable<charclass::Apostrophe>);
 }
 
 }  // namespace
 
 #if defined(_OPENMP)
 
-#include <omp.h>
-
 static void findPerfectHash()
 {
     Timer timer{fmt::format(fg(fmt::color::dark_orange), "total")};
@@ -261,107 +995,212 @@ int main(int argc, char * argv[])
 {
     Timer timer{fmt::format(fg(fmt::color::dark_green), "total")};
 
-    if (argc != 3) {
-        fmt::print(stderr, "usage: {} in.txt out.txt\n", argv[0]);
+    Options options{argc, argv};
+    const auto & positional = options.getPositional();
+    // jobs of a list of requests reuse tables, see countBatch()
+    bool batch = options.has("batch");
+    if (batch ? (positional.size() != 1) : (positional.size() < 2)) {
+        fmt::print(stderr,
+                   "usage: {0} [--utf8] "
+                   "[--words=alpha|alnum|identifier|apostrophe] "
+                   "[--snapshot=counts.snapshot] [--partial] [--shared] "
+                   "[--ngram=1..4] [--stopwords=stopwords.txt] "
+                   "[--min-count=1] [--threads=1] [--cpus=0-3,8] "
+                   "in.txt|dir... out.txt\n"
+                   "       {0} --batch [--utf8] [--words=...] [--partial] "
+                   "[--stopwords=...] [--min-count=1] requests.txt|-\n",
+                   argv[0]);
         return EXIT_FAILURE;
     }
-
     using namespace std::string_view_literals;
-
-    auto inputFile =
-        (argv[1] == "-"sv) ? wrapFile(stdin) : openFile(argv[1], "rb");
-    if (!inputFile) {
-        fmt::print(stderr, "failed to open '{}' file to read\n", argv[1]);
+    Settings settings;
+    settings.utf8 = options.has("utf8");
+    settings.words = options.get("words", "alpha"sv);
+    settings.snapshot = options.get("snapshot");
+    settings.partial = options.has("partial");
+    settings.shared = options.has("shared");
+    settings.stopWords = options.get("stopwords");
+    if (!options.get("ngram", settings.ngram) ||
+        !options.get("min-count", settings.minCount) ||
+        !options.get("threads", settings.threadCount))
+    {
         return EXIT_FAILURE;
     }
-
-    auto outputFile =
-        (argv[2] == "-"sv) ? wrapFile(stdout) : openFile(argv[2], "wb");
-    if (!outputFile) {
-        fmt::print(stderr, "failed to open '{}' file to write\n", argv[2]);
+    if ((settings.ngram < 1) || (settings.ngram > 4)) {
+        fmt::print(stderr, "--ngram should be in range 1..4\n");
         return EXIT_FAILURE;
     }
-
-    std::size_t readSize =
-        readInput(std::begin(input), std::size(input), inputFile);
-    if (readSize == 0) {
-        return EXIT_SUCCESS;
+    if (settings.threadCount == 0) {
+        fmt::print(stderr, "--threads should be positive\n");
+        return EXIT_FAILURE;
     }
-    inputEnd += readSize;
-    timer.report("read input");
-
-    for (Chunk & chunk : hashTable) {
-        chunk.hashesHigh = _mm_set1_epi16(int16_t(kDefaultChecksumHigh));
+    // worker threads pin themselves, one per CPU of the list
+    std::string_view cpuList = options.get("cpus");
+    if (!cpuList.empty()) {
+        if (!parseCpuList(cpuList, settings.cpus)) {
+            fmt::print(stderr,
+                       "--cpus should be a list like 0-3,8 of CPUs available "
+                       "to the process\n");
+            return EXIT_FAILURE;
+        }
+        if (!options.has("threads")) {
+            settings.threadCount = settings.cpus.size();
+        }
     }
-    timer.report("init hashTable");
-
 #if defined(_OPENMP)
-    if ((kFindPerfectHash)) {
-        findPerfectHash();
-        return EXIT_SUCCESS;
+    // otherwise files are counted by the default number of OpenMP threads
+    if (options.has("threads") || !settings.cpus.empty()) {
+        omp_set_num_threads(int(settings.threadCount));
     }
 #endif
-
-    if (kEnableOpenAddressing) {
-        toLower(input, inputEnd);
-        timer.report("make input lowercase");
+    const auto & words = settings.words;
+    constexpr std::string_view kWordDefinitions[] = {
+        "alpha", "alnum", "identifier", "apostrophe"};
+    if (std::find(std::cbegin(kWordDefinitions), std::cend(kWordDefinitions),
+                  words) == std::cend(kWordDefinitions))
+    {
+        fmt::print(stderr, "unknown word definition '{}'\n", words);
+        return EXIT_FAILURE;
+    }
+    if (settings.utf8 && (words != "alpha"sv)) {
+        fmt::print(stderr, "--utf8 supports only --words=alpha\n");
+        return EXIT_FAILURE;
+    }
+    // counts of partial results are summed up by freq-merge
+    if (settings.partial && (settings.minCount > 1)) {
+        fmt::print(stderr, "--partial does not support --min-count\n");
+        return EXIT_FAILURE;
+    }
+    if (!settings.stopWords.empty()) {
+        if (settings.ngram > 1) {
+            fmt::print(stderr, "--ngram does not support --stopwords\n");
+            return EXIT_FAILURE;
+        }
+        if (!InputBuffer{}.read(settings.stopWords)) {
+            fmt::print(stderr, "failed to read '{}' file\n",
+                       settings.stopWords);
+            return EXIT_FAILURE;
+        }
     }
 
-    countWords();
-    timer.report(fmt::format(fg(fmt::color::dark_blue), "count words"));
+    if (batch) {
+        if (settings.shared || !settings.snapshot.empty() ||
+            (settings.ngram > 1))
+        {
+            fmt::print(stderr,
+                       "--batch supports neither --shared nor --snapshot nor "
+                       "--ngram\n");
+            return EXIT_FAILURE;
+        }
+        auto requestsFile = (positional.front() == "-"sv)
+                                ? wrapFile(stdin)
+                                : openFile(positional.front().data(), "rb");
+        if (!requestsFile) {
+            fmt::print(stderr, "failed to open '{}' file to read\n",
+                       positional.front());
+            return EXIT_FAILURE;
+        }
+        return withHashTable(settings, [&](auto & hashTable) {
+            return countBatch(hashTable, settings, requestsFile, timer);
+        });
+    }
 
-    toLower(output, o);
-    timer.report("make output lowercase");
+    std::vector<std::string_view> inputPaths{std::cbegin(positional),
+                                             std::prev(std::cend(positional))};
+    std::string_view outputPath = positional.back();
+    std::error_code errorCode;
+    bool singleInput = (inputPaths.size() == 1) &&
+                       ((inputPaths.front() == "-"sv) ||
+                        !std::filesystem::is_directory(inputPaths.front(),
+                                                       errorCode));
 
-    std::vector<std::pair<uint32_t, std::string_view>> rank;
-    rank.reserve(std::extent_v<decltype(words)> *
-                 std::extent_v<decltype(words), 1>);
+    if ((settings.ngram > 1) &&
+        (!singleInput || settings.partial || !settings.snapshot.empty()))
     {
-        uint32_t hashLow = 0;
-        for (const auto & w : words) {
-            const Chunk & chunk = hashTable[hashLow];
-            uint32_t index = 0;
-            for (uint32_t word : w) {
-                if (word != 0) {
-                    rank.emplace_back(chunk.count[index],
-                                      std::next(output, word));
-                }
-                ++index;
-            }
-            ++hashLow;
-        }
+        fmt::print(stderr,
+                   "--ngram supports neither multiple inputs nor --partial "
+                   "nor --snapshot\n");
+        return EXIT_FAILURE;
     }
-    fmt::print(stderr, "load factor = {:.3}\n",
-               double(rank.size()) / double(rank.capacity()));
-    timer.report("collect word counts");
 
-    auto less = [](auto && lhs, auto && rhs) {
-        return std::tie(rhs.first, lhs.second) <
-               std::tie(lhs.first, rhs.second);
-    };
-    std::sort(std::begin(rank), std::end(rank), less);
-    timer.report(fmt::format(fg(fmt::color::dark_orange), "sort words"));
+    // positional arguments are whole argv[] entries, hence NUL-terminated
+    auto outputFile = (outputPath == "-"sv) ? wrapFile(stdout)
+                                            : openFile(outputPath.data(), "wb");
+    if (!outputFile) {
+        fmt::print(stderr, "failed to open '{}' file to write\n", outputPath);
+        return EXIT_FAILURE;
+    }
 
-    OutputStream<> outputStream{outputFile};
-    for (const auto & [count, word] : rank) {
-        if (!outputStream.print(count)) {
-            fmt::print(stderr, "output failure\n");
+    auto inputFile = wrapFile(nullptr);
+    Source source;
+    bool stream = false;
+    Compression compression = Compression::kNone;
+    if (singleInput) {
+        inputFile = (inputPaths.front() == "-"sv)
+                        ? wrapFile(stdin)
+                        : openFile(inputPaths.front().data(), "rb");
+        if (!inputFile) {
+            fmt::print(stderr, "failed to open '{}' file to read\n",
+                       inputPaths.front());
             return EXIT_FAILURE;
         }
-        if (!outputStream.putChar(' ')) {
-            fmt::print(stderr, "output failure\n");
+        source = openSource(inputFile, compression);
+        if (!source) {
             return EXIT_FAILURE;
         }
-        if (!outputStream.print(word.data())) {
-            fmt::print(stderr, "output failure\n");
+        if (compression != Compression::kNone) {
+            fmt::print(stderr, "{} compressed input\n",
+                       getCompressionName(compression));
+        }
+        // stdin and compressed input are counted while being read, unless
+        // words depend on bytes which can be in the next block (inner bytes
+        // and UTF-8 sequences)
+        stream = ((inputPaths.front() == "-"sv) ||
+                  (compression != Compression::kNone)) &&
+                 !settings.utf8 && (words != "apostrophe"sv);
+    }
+
+    if (stream) {
+        settings.stream = std::move(source);
+    } else if (singleInput) {
+        if (!settings.cpus.empty() && (compression == Compression::kNone) &&
+            (inputPaths.front() != "-"sv))
+        {
+            auto inputSize = std::filesystem::file_size(inputPaths.front(),
+                                                        errorCode);
+            if (!errorCode && (inputSize < std::size(input))) {
+                placeInput(std::size_t(inputSize), settings);
+                timer.report("place input");
+            }
+        }
+        std::ptrdiff_t readSize =
+            readInput(std::begin(input), std::size(input), source);
+        if (readSize < 0) {
             return EXIT_FAILURE;
         }
-        if (!outputStream.putChar('\n')) {
-            fmt::print(stderr, "output failure\n");
+        inputEnd += readSize;
+        timer.report("read input");
+
+#if defined(_OPENMP)
+        if ((kFindPerfectHash)) {
+            findPerfectHash();
+            return EXIT_SUCCESS;
+        }
+#endif
+    } else {
+        if (!listInputFiles(inputPaths, settings.inputFiles)) {
             return EXIT_FAILURE;
         }
+        std::uintmax_t inputSize = 0;
+        for (const auto & inputFile : settings.inputFiles) {
+            inputSize += inputFile.size;
+        }
+        fmt::print(stderr, "{} input files, input size = {} bytes\n",
+                   settings.inputFiles.size(), inputSize);
+        timer.report("list input files");
     }
-    timer.report("write output");
 
-    return EXIT_SUCCESS;
+    return withHashTable(settings, [&](auto & hashTable) {
+        return countWords(hashTable, settings, outputFile, timer);
+    });
 }
@@ -0,0 +1,506 @@
+#pragma once
+
+#include "arena.hpp"
+#include "charclass.hpp"
+#include "helpers.hpp"
+#include "tokenizer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <limits>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <cstdint>
+
+// Open addressing perfect hash: hash table of 8-way chunks addressed by the
+// low bits of CRC32 of a word, the high bits are stored as 16-bit tags
+namespace oaph
+{
+
+// perfect hash seeds: 10675, 98363, 102779, 103674, 105067, 194036, 242662,
+// 290547, 313385, ... seeds 8, 23, 89, 126, 181, 331, 381, 507, ... are also
+// perfect hash seeds, but kHashTableOrder-bit prefix of hash values gives more
+// than 8 collisions per unique one, thus requires an open addressing for
+// hashtable enabled
+constexpr uint32_t kInitialChecksum = 10675;
+constexpr uint16_t kDefaultChecksumHigh = 0xFFFF;
+
+// counters are the low 16 bits of counts, so that two chunks fit into a cache
+// line; carries out of them go to a side table of 64-bit spills, which a word
+// touches once per 2^16 occurrences
+struct alignas(2 * sizeof(__m128i)) Chunk
+{
+    __m128i hashesHigh;
+    uint16_t count[sizeof(__m128i) / sizeof(uint16_t)];
+};
+
+static_assert((alignof(Chunk) % alignof(__m128i)) == 0, "!");
+static_assert((kHardwareDestructiveInterferenceSize % sizeof(Chunk)) == 0, "!");
+
+constexpr uint64_t kCounterMask = std::numeric_limits<uint16_t>::max();
+
+// adds count to a counter of a chunk, the carry to its spill
+FORCEINLINE inline void addCount(uint16_t & counter, uint64_t & spill,
+                                 uint64_t count)
+{
+    uint64_t sum = counter + count;
+    counter = uint16_t(sum);
+    if UNLIKELY (sum > kCounterMask) {
+        spill += sum & ~kCounterMask;
+    }
+}
+
+// thread-safe addCount(): the counter wraps atomically, the carry is derived
+// from its previous value
+FORCEINLINE inline void addCountShared(uint16_t & counter, uint64_t & spill,
+                                       uint64_t count)
+{
+    auto low = uint16_t(count);
+    uint16_t previous = std::atomic_ref<uint16_t>{counter}.fetch_add(
+        low, std::memory_order_relaxed);
+    uint64_t carry =
+        (count & ~kCounterMask) + ((previous + uint64_t(low)) & ~kCounterMask);
+    if UNLIKELY (carry != 0) {
+        std::atomic_ref<uint64_t>{spill}.fetch_add(carry,
+                                                   std::memory_order_relaxed);
+    }
+}
+
+inline uint64_t getCount(uint16_t counter, uint64_t spill)
+{
+    return spill + counter;
+}
+
+// words shorter than kInlineKeySize are verified by their inline keys alone:
+// the first bytes of a word zero-padded to 16, a longer word has no zeros
+// there, thus it is not equal to the inline key of a shorter one
+constexpr uint32_t kInlineKeySize = sizeof(__m128i);
+constexpr uintptr_t kPageSize = 4096;
+
+// inline key of a word, bytes past it are read unless they are on other page
+inline __m128i loadKey(const char * word, uint32_t len)
+{
+    auto size = std::min<uint32_t>(len, kInlineKeySize);
+    if UNLIKELY ((reinterpret_cast<uintptr_t>(word) & (kPageSize - 1)) >
+                 (kPageSize - kInlineKeySize))
+    {
+        alignas(__m128i) char bytes[kInlineKeySize] = {};
+        std::copy_n(word, size, bytes);
+        return _mm_load_si128(reinterpret_cast<const __m128i *>(bytes));
+    }
+    __m128i key = _mm_loadu_si128(reinterpret_cast<const __m128i *>(word));
+    __m128i offsets = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12,
+                                    13, 14, 15);
+    return _mm_and_si128(
+        key, _mm_cmpgt_epi8(_mm_set1_epi8(int8_t(size)), offsets));
+}
+
+inline bool isEqualKey(const __m128i & lhs, __m128i rhs)
+{
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(&lhs), rhs)) ==
+           0xFFFF;
+}
+
+constexpr auto kHashTableOrder =
+    std::numeric_limits<uint16_t>::digits +
+    1;  // one bit window to distinct kDefaultChecksumHigh
+constexpr uint32_t kHashTableMask = (uint32_t(1) << kHashTableOrder) - 1;
+
+// kEnableOpenAddressing requires a key comparison, thus input should be made
+// lowercase by toLower<CharClass>() before counting; perfect hash seeds are
+// found for charclass::Alpha words
+template<bool kEnableOpenAddressing, typename CharClass = charclass::Alpha>
+struct HashTable
+{
+    Chunk chunks[1 << kHashTableOrder];
+
+    WordArena<> arena;
+    // references of words in arena, 0 for unused hashes only
+    uint32_t words[std::extent_v<decltype(chunks)>]
+                  [std::extent_v<decltype(Chunk::count)>];
+    // loadKey() of words, compared before (mostly instead of) words in arena;
+    // unused by perfect hashing. Eight keys do not fit into the cache line of
+    // their chunk, and placed next to it they would spread chunks, which are
+    // probed by tags, over more lines
+    __m128i keys[std::extent_v<decltype(chunks)>]
+                [std::extent_v<decltype(Chunk::count)>];
+    // carries of counters, see addCount(); pages are touched by hot words only
+    uint64_t spills[std::extent_v<decltype(chunks)>]
+                   [std::extent_v<decltype(Chunk::count)>];
+    // chunks in use, listed as they get the first word (always to the first
+    // slot), for reset()
+    uint32_t touched[std::extent_v<decltype(chunks)>];
+    uint32_t touchedCount;
+
+    void init()
+    {
+        for (Chunk & chunk : chunks) {
+            chunk.hashesHigh = _mm_set1_epi16(int16_t(kDefaultChecksumHigh));
+        }
+        touchedCount = 0;
+        arena.release();  // words of the previous init(), if any
+        arena.init();
+    }
+
+    // init() of an initialized table in time proportional to the number of
+    // chunks in use, segments of arena stay mapped
+    void reset()
+    {
+        for (uint32_t i = 0; i < touchedCount; ++i) {
+            uint32_t hashLow = touched[i];
+            Chunk & chunk = chunks[hashLow];
+            chunk.hashesHigh = _mm_set1_epi16(int16_t(kDefaultChecksumHigh));
+            std::fill(std::begin(chunk.count), std::end(chunk.count), 0);
+            std::fill(std::begin(words[hashLow]), std::end(words[hashLow]), 0);
+            std::fill(std::begin(keys[hashLow]), std::end(keys[hashLow]),
+                      _mm_setzero_si128());
+            // writes would back untouched pages of spills by memory
+            auto & spill = spills[hashLow];
+            if (std::any_of(std::cbegin(spill), std::cend(spill),
+                            [](uint64_t carry) { return carry != 0; }))
+            {
+                std::fill(std::begin(spill), std::end(spill), 0);
+            }
+        }
+        touchedCount = 0;
+        arena.clear();
+    }
+
+    // the word of a slot is compared in arena only if it is long, so that a
+    // lookup of a short word does not touch arena
+    bool isEqual(uint32_t hashLow, uint32_t index, __m128i key,
+                 const char * word, uint32_t len) const
+    {
+        return isEqualKey(keys[hashLow][index], key) &&
+               ((len < kInlineKeySize) ||
+                arena.isEqual(words[hashLow][index], word, len));
+    }
+
+    // returns the reference of the word in arena, 0 if arena is full; counts
+    // wrap modulo 2^64, so uint64_t(0) - n subtracts n from a counted word
+    uint32_t incCounter(uint32_t hash, const char * __restrict wordEnd,
+                        uint32_t len, uint64_t count = 1)
+    {
+        uint32_t hashLow = hash & kHashTableMask;
+        uint32_t hashHigh = hash >> kHashTableOrder;
+        const char * word = std::prev(wordEnd, len);
+        __m128i key = kEnableOpenAddressing ? loadKey(word, len)
+                                            : _mm_setzero_si128();
+        for (;;) {
+            Chunk & chunk = chunks[hashLow];
+            __m128i hashesHigh = _mm_load_si128(&chunk.hashesHigh);
+            __m128i mask =
+                _mm_cmpeq_epi16(hashesHigh, _mm_set1_epi16(int16_t(hashHigh)));
+            uint16_t m = uint16_t(_mm_movemask_epi8(mask));
+            unsigned long index;
+            if LIKELY (m != 0) {
+                BSF(index, m);
+                index /= 2;
+                if (kEnableOpenAddressing &&
+                    UNLIKELY(!isEqual(hashLow, index, key, word, len)))
+                {
+                    // linear probing
+                    hashLow = (hashLow + 1) & kHashTableMask;
+                    continue;
+                }
+            } else {
+                m = uint16_t(_mm_movemask_epi8(hashesHigh)) &
+                    0b1010101010101010u;
+                if (kEnableOpenAddressing && UNLIKELY(m == 0)) {
+                    // linear probing
+                    hashLow = (hashLow + 1) & kHashTableMask;
+                    continue;
+                }
+                uint32_t reference = arena.append(word, len);
+                if UNLIKELY (reference == 0) {
+                    return 0;
+                }
+                BSF(index, m);
+                index /= 2;
+                reinterpret_cast<uint16_t *>(&chunk.hashesHigh)[index] =
+                    hashHigh;
+                words[hashLow][index] = reference;
+                if constexpr (kEnableOpenAddressing) {
+                    _mm_store_si128(&keys[hashLow][index], key);
+                }
+                if (index == 0) {
+                    touched[touchedCount++] = hashLow;
+                }
+            }
+            addCount(chunk.count[index], spills[hashLow][index], count);
+            return words[hashLow][index];
+        }
+    }
+
+    // the chunk and the slot of a word, the slot is past the chunk if the
+    // word is not counted; perfect hashing matches tags only
+    std::pair<uint32_t, uint32_t> findSlot(uint32_t hash, const char * wordEnd,
+                                           uint32_t len) const
+    {
+        constexpr auto kNotFound = uint32_t(std::extent_v<decltype(words), 1>);
+        uint32_t hashLow = hash & kHashTableMask;
+        uint32_t hashHigh = hash >> kHashTableOrder;
+        const char * word = std::prev(wordEnd, len);
+        __m128i key = kEnableOpenAddressing ? loadKey(word, len)
+                                            : _mm_setzero_si128();
+        for (;; hashLow = (hashLow + 1) & kHashTableMask) {
+            const Chunk & chunk = chunks[hashLow];
+            __m128i hashesHigh = _mm_load_si128(&chunk.hashesHigh);
+            __m128i mask =
+                _mm_cmpeq_epi16(hashesHigh, _mm_set1_epi16(int16_t(hashHigh)));
+            uint16_t m = uint16_t(_mm_movemask_epi8(mask));
+            if (m == 0) {
+                m = uint16_t(_mm_movemask_epi8(hashesHigh)) &
+                    0b1010101010101010u;
+                if (!kEnableOpenAddressing || (m != 0)) {
+                    return {hashLow, kNotFound};
+                }
+                continue;
+            }
+            unsigned long index;
+            BSF(index, m);
+            index /= 2;
+            if (!kEnableOpenAddressing ||
+                isEqual(hashLow, uint32_t(index), key, word, len))
+            {
+                return {hashLow, uint32_t(index)};
+            }
+        }
+    }
+
+    // the count of a word, 0 if it is not counted
+    uint64_t getWordCount(uint32_t hash, const char * wordEnd,
+                          uint32_t len) const
+    {
+        auto [hashLow, index] = findSlot(hash, wordEnd, len);
+        if (index == std::extent_v<decltype(words), 1>) {
+            return 0;
+        }
+        return getCount(chunks[hashLow].count[index], spills[hashLow][index]);
+    }
+
+    // the reference of a word in arena, 0 if it is not counted; wordEnd[0]
+    // should be NUL, arena should be made lowercase for perfect hashing
+    uint32_t findWord(uint32_t hash, const char * wordEnd, uint32_t len) const
+    {
+        auto [hashLow, index] = findSlot(hash, wordEnd, len);
+        if (index == std::extent_v<decltype(words), 1>) {
+            return 0;
+        }
+        uint32_t word = words[hashLow][index];
+        if (!kEnableOpenAddressing &&
+            !arena.isEqual(word, std::prev(wordEnd, len), len))
+        {
+            return 0;  // a tag of other word
+        }
+        return word;
+    }
+
+    void countWords(const char * beg, const char * end)
+    {
+        uint32_t hash = kInitialChecksum;
+        uint32_t len = 0;
+        auto onWord = [this](uint32_t hash, const char * wordEnd,
+                             uint32_t len) { incCounter(hash, wordEnd, len); };
+        tokenize<kEnableOpenAddressing, CharClass>(beg, end, kInitialChecksum,
+                                                   hash, len, onWord);
+        if (len != 0) {
+            incCounter(hash, end, len);
+        }
+    }
+
+    // countWords() for consecutive blocks of a stream: a word which is not
+    // finished at end is left in hash and len (initially kInitialChecksum and
+    // 0), its bytes should precede the next block (see AsyncReader)
+    void countWords(const char * beg, const char * end, uint32_t & hash,
+                    uint32_t & len)
+    {
+        auto onWord = [this](uint32_t hash, const char * wordEnd,
+                             uint32_t len) { incCounter(hash, wordEnd, len); };
+        tokenize<kEnableOpenAddressing, CharClass>(beg, end, kInitialChecksum,
+                                                   hash, len, onWord);
+    }
+
+    // countWords() for the words starting in the task [beg, end) of input
+    // [inputBeg, inputEnd), see tokenizeTask()
+    void countTaskWords(const char * inputBeg, const char * beg,
+                        const char * end, const char * inputEnd)
+    {
+        auto onWord = [this](uint32_t hash, const char * wordEnd,
+                             uint32_t len) { incCounter(hash, wordEnd, len); };
+        tokenizeTask<kEnableOpenAddressing, CharClass>(
+            inputBeg, beg, end, inputEnd, kInitialChecksum, onWord);
+    }
+
+    // Thread-safe incCounter() for counting into a table shared by threads: a
+    // tag slot is claimed by 16-bit CAS, always the first empty one of a chunk,
+    // so tags stay unique within a chunk; only then the word is stored to a
+    // record reserved in arena, so that no record is left unreferenced, and
+    // published by a release store of its reference. Returns the counter, its
+    // spill and the stored word, nulls if arena is full.
+    std::tuple<uint16_t *, uint64_t *, const char *> incCounterShared(
+        uint32_t hash, const char * __restrict wordEnd, uint32_t len,
+        uint64_t count = 1)
+    {
+        static_assert(kEnableOpenAddressing, "key comparison is required");
+        uint32_t hashLow = hash & kHashTableMask;
+        uint32_t hashHigh = hash >> kHashTableOrder;
+        for (;;) {
+            Chunk & chunk = chunks[hashLow];
+            // claimed tags never change, so the plain vector load is safe
+            __m128i hashesHigh = _mm_load_si128(&chunk.hashesHigh);
+            __m128i mask =
+                _mm_cmpeq_epi16(hashesHigh, _mm_set1_epi16(int16_t(hashHigh)));
+            uint16_t m = uint16_t(_mm_movemask_epi8(mask));
+            unsigned long index;
+            uint32_t word;
+            if LIKELY (m != 0) {
+                BSF(index, m);
+                index /= 2;
+                std::atomic_ref<uint32_t> wordRef{words[hashLow][index]};
+                while ((word = wordRef.load(std::memory_order_acquire)) == 0) {
+                    // the word is being stored by other thread, or is never
+                    // stored, if the arena got full
+                    if UNLIKELY (arena.isFullShared()) {
+                        return {nullptr, nullptr, nullptr};
+                    }
+                    _mm_pause();
+                }
+                if UNLIKELY (!arena.isEqual(word, std::prev(wordEnd, len),
+                                            len))
+                {
+                    // linear probing
+                    hashLow = (hashLow + 1) & kHashTableMask;
+                    continue;
+                }
+            } else {
+                m = uint16_t(_mm_movemask_epi8(hashesHigh)) &
+                    0b1010101010101010u;
+                if UNLIKELY (m == 0) {
+                    // linear probing
+                    hashLow = (hashLow + 1) & kHashTableMask;
+                    continue;
+                }
+                BSF(index, m);
+                index /= 2;
+                uint16_t emptyHashHigh = kDefaultChecksumHigh;
+                std::atomic_ref<uint16_t> hashHighRef{
+                    reinterpret_cast<uint16_t *>(&chunk.hashesHigh)[index]};
+                if (!hashHighRef.compare_exchange_strong(
+                        emptyHashHigh, uint16_t(hashHigh),
+                        std::memory_order_acq_rel))
+                {
+                    continue;  // claimed by other thread, probe chunk again
+                }
+                word = arena.reserveShared(len);
+                if UNLIKELY (word == 0) {
+                    return {nullptr, nullptr, nullptr};
+                }
+                arena.writeRecord(word, std::prev(wordEnd, len), len);
+                // keys are not compared by threads, but stay consistent for
+                // incCounter() of the table
+                _mm_store_si128(&keys[hashLow][index],
+                                loadKey(std::prev(wordEnd, len), len));
+                std::atomic_ref<uint32_t>{words[hashLow][index]}.store(
+                    word, std::memory_order_release);
+                if (index == 0) {
+                    touched[std::atomic_ref<uint32_t>{touchedCount}.fetch_add(
+                        1, std::memory_order_relaxed)] = hashLow;
+                }
+            }
+            addCountShared(chunk.count[index], spills[hashLow][index], count);
+            return {&chunk.count[index], &spills[hashLow][index],
+                    arena.getData(word)};
+        }
+    }
+
+    // Thread-safe countWords(): increments of recently seen words (mostly the
+    // hottest ones) are combined in a small per-thread cache and flushed by a
+    // single addCountShared(), so that their chunks are not bounced between
+    // cores
+    void countWordsShared(const char * beg, const char * end)
+    {
+        countTaskWordsShared(beg, beg, end, end);
+    }
+
+    // countTaskWords() for the shared table
+    void countTaskWordsShared(const char * inputBeg, const char * beg,
+                              const char * end, const char * inputEnd)
+    {
+        struct CachedCounter
+        {
+            uint32_t hash = 0;
+            uint32_t pending = 0;
+            uint16_t * counter = nullptr;
+            uint64_t * spill = nullptr;
+            const char * word = nullptr;
+        };
+        CachedCounter cache[256];
+        auto flush = [](CachedCounter & cachedCounter) {
+            if (cachedCounter.pending != 0) {
+                addCountShared(*cachedCounter.counter, *cachedCounter.spill,
+                               cachedCounter.pending);
+                cachedCounter.pending = 0;
+            }
+        };
+        auto onWord = [&](uint32_t hash, const char * wordEnd, uint32_t len) {
+            CachedCounter & cachedCounter = cache[hash % std::size(cache)];
+            if ((cachedCounter.hash == hash) && cachedCounter.counter &&
+                std::equal(std::prev(wordEnd, len), std::next(wordEnd),
+                           cachedCounter.word))
+            {
+                ++cachedCounter.pending;
+                return;
+            }
+            flush(cachedCounter);
+            cachedCounter.hash = hash;
+            std::tie(cachedCounter.counter, cachedCounter.spill,
+                     cachedCounter.word) = incCounterShared(hash, wordEnd, len);
+        };
+        tokenizeTask<kEnableOpenAddressing, CharClass>(
+            inputBeg, beg, end, inputEnd, kInitialChecksum, onWord);
+        for (CachedCounter & cachedCounter : cache) {
+            flush(cachedCounter);
+        }
+    }
+
+    // adds counts of other table, its words should be made lowercase
+    void merge(const HashTable & other)
+    {
+        other.forEachWord([this, &other](uint64_t count, uint32_t word) {
+            std::string_view w = other.arena.getWord(word);
+            uint32_t hash = kInitialChecksum;
+            for (char c : w) {
+                hash = _mm_crc32_u8(hash, uint8_t(c));
+            }
+            incCounter(hash, std::next(w.data(), std::ptrdiff_t(w.size())),
+                       uint32_t(w.size()), count);
+        });
+        arena.full = arena.full || other.arena.full;
+    }
+
+    // onWord(count, word) for every counted word, word is a reference in arena
+    template<typename OnWord>
+    void forEachWord(OnWord && onWord) const
+    {
+        uint32_t hashLow = 0;
+        for (const auto & w : words) {
+            const Chunk & chunk = chunks[hashLow];
+            uint32_t index = 0;
+            for (uint32_t word : w) {
+                if (word != 0) {
+                    onWord(getCount(chunk.count[index], spills[hashLow][index]),
+                           word);
+                }
+                ++index;
+            }
+            ++hashLow;
+        }
+    }
+};
+
+}  // namespace oaph
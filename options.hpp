@@ -0,0 +1,139 @@
+#pragma once
+
+#include <fmt/format.h>
+
+#include <charconv>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+// "--name=value" and "--name" are named options, everything else (including
+// "-", which stands for stdin or stdout) is positional
+class Options
+{
+public:
+    Options(int argc, char * argv[])
+    {
+        using namespace std::string_view_literals;
+        bool positionalOnly = false;
+        for (int i = 1; i < argc; ++i) {
+            std::string_view arg = argv[i];
+            if (positionalOnly || !arg.starts_with("--"sv)) {
+                positional.push_back(arg);
+            } else if (arg == "--"sv) {
+                positionalOnly = true;
+            } else {
+                arg.remove_prefix(2);
+                auto eq = arg.find('=');
+                if (eq == std::string_view::npos) {
+                    named[arg] = {};
+                } else {
+                    named[arg.substr(0, eq)] = arg.substr(eq + 1);
+                }
+            }
+        }
+    }
+
+    const std::vector<std::string_view> & getPositional() const
+    {
+        return positional;
+    }
+
+    bool has(std::string_view name) const
+    {
+        return named.contains(name);
+    }
+
+    std::string_view get(std::string_view name,
+                         std::string_view defaultValue = {}) const
+    {
+        auto it = named.find(name);
+        return (it == named.end()) ? defaultValue : it->second;
+    }
+
+    // leaves value untouched if option is absent
+    template<typename T>
+    bool get(std::string_view name, T & value) const
+    {
+        auto it = named.find(name);
+        if (it == named.end()) {
+            return true;
+        }
+        std::string_view s = it->second;
+        const char * end = s.data() + s.size();
+        const char * ptr = nullptr;
+        auto ec = std::errc::invalid_argument;
+        if constexpr (std::is_floating_point_v<T>) {
+            // floating point std::from_chars is missing in libc++
+            std::string string{s};
+            char * stringEnd = nullptr;
+            T result = T(std::strtold(string.c_str(), &stringEnd));
+            if (!string.empty() && stringEnd == string.data() + string.size())
+            {
+                value = result;
+                ptr = end;
+                ec = std::errc{};
+            }
+        } else {
+            auto result = std::from_chars(s.data(), end, value);
+            ptr = result.ptr;
+            ec = result.ec;
+        }
+        if (ec != std::errc{} || ptr != end) {
+            fmt::print(stderr, "invalid value '{}' of option --{}\n", s, name);
+            return false;
+        }
+        return true;
+    }
+
+    // accepts binary suffixes K, M, G and T
+    bool getSize(std::string_view name, uint64_t & value) const
+    {
+        auto it = named.find(name);
+        if (it == named.end()) {
+            return true;
+        }
+        std::string_view s = it->second;
+        uint64_t size = 0;
+        auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), size);
+        if (ec == std::errc{} && ptr != s.data() + s.size() &&
+            std::next(ptr) == s.data() + s.size())
+        {
+            switch (*ptr) {
+            case 'K':
+                size <<= 10;
+                break;
+            case 'M':
+                size <<= 20;
+                break;
+            case 'G':
+                size <<= 30;
+                break;
+            case 'T':
+                size <<= 40;
+                break;
+            default:
+                ec = std::errc::invalid_argument;
+            }
+            ptr = s.data() + s.size();
+        }
+        if (ec != std::errc{} || ptr != s.data() + s.size()) {
+            fmt::print(stderr, "invalid value '{}' of option --{}\n", s, name);
+            return false;
+        }
+        value = size;
+        return true;
+    }
+
+private:
+    std::vector<std::string_view> positional;
+    std::unordered_map<std::string_view, std::string_view> named;
+};
@@ -0,0 +1,222 @@
+#pragma once
+
+#include "io.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+// Partial result: "freqpart" magic, varint version, varint length and name of
+// the word definition, then records of words in ascending byte order: LEB128
+// varints of the length of the prefix shared with the previous word, of the
+// suffix length, the suffix itself and a varint count. A record with empty
+// suffix ends the stream.
+constexpr char kPartialMagic[8] = {'f', 'r', 'e', 'q', 'p', 'a', 'r', 't'};
+constexpr uint64_t kPartialVersion = 1;
+
+template<std::size_t bufferSize = 131072>
+class PartialWriter
+{
+public:
+    PartialWriter(const File & outputFile, std::string_view words)
+        : outputStream{outputFile}
+    {
+        success = outputStream.print(
+                      std::string_view{kPartialMagic, sizeof kPartialMagic}) &&
+                  putVarint(kPartialVersion) && putVarint(words.size()) &&
+                  outputStream.print(words);
+    }
+
+    // words are expected in strictly ascending order
+    bool write(std::string_view word, uint64_t count)
+    {
+        assert(!word.empty());
+        assert(previousWord.empty() ||
+               (std::string_view{previousWord} < word));
+        auto mismatch =
+            std::mismatch(std::cbegin(word), std::cend(word),
+                          std::cbegin(previousWord), std::cend(previousWord));
+        auto shared =
+            std::size_t(std::distance(std::cbegin(word), mismatch.first));
+        auto suffix = word.substr(shared);
+        success = success && putVarint(shared) && putVarint(suffix.size()) &&
+                  outputStream.print(suffix) && putVarint(count);
+        previousWord.resize(shared);
+        previousWord.append(suffix);
+        return success;
+    }
+
+    bool finish()
+    {
+        success = success && putVarint(0) && putVarint(0) &&
+                  outputStream.flush();
+        return success;
+    }
+
+private:
+    OutputStream<bufferSize> outputStream;
+    std::string previousWord;
+    bool success = true;
+
+    bool putVarint(uint64_t value)
+    {
+        while (value >= 0x80) {
+            if (!outputStream.putChar(char(0x80 | (value & 0x7F)))) {
+                return false;
+            }
+            value >>= 7;
+        }
+        return outputStream.putChar(char(value));
+    }
+};
+
+// Streaming reader with a fixed-size buffer
+class PartialReader
+{
+public:
+    PartialReader(File inputFile, std::string_view path)
+        : inputFile{std::move(inputFile)}, path{path}
+    {
+        char magic[sizeof kPartialMagic];
+        uint64_t version = 0;
+        uint64_t wordsSize = 0;
+        if (!read(magic, sizeof magic) ||
+            (std::memcmp(magic, kPartialMagic, sizeof magic) != 0) ||
+            !getVarint(version) || (version != kPartialVersion) ||
+            !getVarint(wordsSize) || (wordsSize > 64))
+        {
+            fail("not a partial result or unsupported version");
+            return;
+        }
+        words.resize(wordsSize);
+        if (!read(words.data(), words.size())) {
+            fail("truncated header");
+        }
+    }
+
+    PartialReader(const PartialReader &) = delete;
+    PartialReader & operator=(const PartialReader &) = delete;
+
+    // advances to the next word, false at the end of stream or on failure
+    bool next()
+    {
+        if (failed) {
+            return false;
+        }
+        uint64_t shared = 0;
+        uint64_t suffixSize = 0;
+        if (!getVarint(shared) || !getVarint(suffixSize)) {
+            return fail("truncated record");
+        }
+        if (suffixSize == 0) {
+            finished = true;
+            return false;
+        }
+        if ((shared > currentWord.size()) || (suffixSize > kMaxWordSize)) {
+            return fail("corrupted record");
+        }
+        currentWord.resize(std::size_t(shared + suffixSize));
+        if (!read(std::next(currentWord.data(), std::ptrdiff_t(shared)),
+                  std::size_t(suffixSize)) ||
+            !getVarint(currentCount))
+        {
+            return fail("truncated record");
+        }
+        return true;
+    }
+
+    std::string_view word() const
+    {
+        return currentWord;
+    }
+
+    uint64_t count() const
+    {
+        return currentCount;
+    }
+
+    // word definition the partial result was counted with
+    std::string_view getWords() const
+    {
+        return words;
+    }
+
+    // the stream is truncated or corrupted
+    bool isFailed() const
+    {
+        return failed;
+    }
+
+    bool isFinished() const
+    {
+        return finished;
+    }
+
+private:
+    static constexpr uint64_t kMaxWordSize = 1 << 20;
+
+    File inputFile;
+    std::string path;
+    std::string words;
+    std::string currentWord;
+    uint64_t currentCount = 0;
+    bool failed = false;
+    bool finished = false;
+
+    char buffer[1 << 16];
+    std::size_t position = 0;
+    std::size_t size = 0;
+
+    bool fail(std::string_view what)
+    {
+        fmt::print(stderr, "'{}': {}\n", path, what);
+        failed = true;
+        return false;
+    }
+
+    bool refill()
+    {
+        position = 0;
+        size = std::fread(buffer, 1, sizeof buffer, inputFile.get());
+        return size != 0;
+    }
+
+    bool read(char * data, std::size_t count)
+    {
+        while (count != 0) {
+            if ((position == size) && !refill()) {
+                return false;
+            }
+            auto chunk = std::min(count, size - position);
+            data = std::copy_n(std::next(buffer, position), chunk, data);
+            position += chunk;
+            count -= chunk;
+        }
+        return true;
+    }
+
+    bool getVarint(uint64_t & value)
+    {
+        value = 0;
+        for (uint32_t shift = 0; shift < 64; shift += 7) {
+            if ((position == size) && !refill()) {
+                return false;
+            }
+            auto byte = uint8_t(buffer[position++]);
+            value |= uint64_t(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <string_view>
+#include <tuple>
+
+#include <cstdint>
+
+// Orders (count, word) pairs by descending count, then by ascending word
+struct RankLess
+{
+    template<typename T>
+    bool operator()(const T & lhs, const T & rhs) const
+    {
+        return std::tie(rhs.first, lhs.second) <
+               std::tie(lhs.first, rhs.second);
+    }
+};
+
+// Orders (count, word) pairs by descending count only, for std::stable_sort of
+// lexicographically ordered ranks
+struct RankCountLess
+{
+    template<typename T>
+    bool operator()(const T & lhs, const T & rhs) const
+    {
+        return rhs.first < lhs.first;
+    }
+};
+
+// Big-endian first 8 bytes of a word, NUL-padded: prefixes compare as integers
+// in the same order as words compare as strings of unsigned chars
+inline uint64_t getWordPrefix(std::string_view word)
+{
+    uint64_t prefix = 0;
+    for (std::size_t i = 0; i < sizeof prefix; ++i) {
+        prefix <<= 8;
+        if (i < word.size()) {
+            prefix |= uint8_t(word[i]);
+        }
+    }
+    return prefix;
+}
+
+// NUL-terminated word
+inline uint64_t getWordPrefix(const char * word)
+{
+    uint64_t prefix = 0;
+    bool terminated = false;
+    for (std::size_t i = 0; i < sizeof prefix; ++i) {
+        prefix <<= 8;
+        terminated = terminated || (word[i] == '\0');
+        if (!terminated) {
+            prefix |= uint8_t(word[i]);
+        }
+    }
+    return prefix;
+}
+
+// Rank entry with the prefix of the word inline: the word itself (e.g. an
+// offset in an arena) is only dereferenced if counts and prefixes are equal
+template<typename Word>
+struct PrefixRankEntry
+{
+    uint64_t prefix;
+    uint64_t count;  // 32-bit counts wrap on aggregations of terabytes
+    Word word;
+};
+
+static_assert(sizeof(PrefixRankEntry<uint32_t>) == 24, "!");
+
+// RankLess for PrefixRankEntry, wordLess(lhs, rhs) compares words which have
+// equal prefixes
+template<typename WordLess>
+struct PrefixRankLess
+{
+    WordLess wordLess;
+
+    template<typename Word>
+    bool operator()(const PrefixRankEntry<Word> & lhs,
+                    const PrefixRankEntry<Word> & rhs) const
+    {
+        if (lhs.count != rhs.count) {
+            return rhs.count < lhs.count;
+        }
+        if (lhs.prefix != rhs.prefix) {
+            return lhs.prefix < rhs.prefix;
+        }
+        return wordLess(lhs.word, rhs.word);
+    }
+};
+
+template<typename WordLess>
+PrefixRankLess(WordLess) -> PrefixRankLess<WordLess>;
@@ -0,0 +1,43 @@
+#! /usr/bin/bash
+
+set -ueo pipefail
+
+if [[ ! $# -ge 2 || ! -x $1 || ! -x $2 ]]
+then
+    >&2 echo "Usage: bash scale.bash PATH_TO_EXECUTABLE PATH_TO_GENERATE [SIZES [VOCABULARIES [ZIPF]]]"
+    exit 2
+fi
+
+EXECUTABLE="$( realpath "$1" )"
+GENERATE="$( realpath "$2" )"
+SIZES="${3:-1M 16M 256M}"
+VOCABULARIES="${4:-1000 100000 1000000}"
+ZIPF="${5:-1.0}"
+
+if ! WORKSPACE="$( mktemp -d --tmpdir 'freq.XXXXXX' )"
+then
+    >&2 echo "Unable to create temporary directory"
+    exit 6
+fi
+trap 'rm -r "$WORKSPACE"' EXIT
+
+# Note: oaph and sparsest use CRC seeds which are perfect for pg.txt only
+for SIZE in $SIZES
+do
+    for VOCABULARY in $VOCABULARIES
+    do
+        "$GENERATE" --size="$SIZE" --vocabulary="$VOCABULARY" --zipf="$ZIPF" \
+            --capitalized=0.1 --punctuation=0.1 \
+            "$WORKSPACE/in.txt" "$WORKSPACE/expected.txt" 2>/dev/null
+        echo "size $SIZE vocabulary $VOCABULARY zipf $ZIPF"
+        LC_ALL=C "$EXECUTABLE" "$WORKSPACE/in.txt" "$WORKSPACE/out.txt" 2>&1 \
+            | grep -E '^(time|memory) \(.*(count words|total)'
+        if cmp --quiet "$WORKSPACE/expected.txt" "$WORKSPACE/out.txt"
+        then
+            echo "OK"
+        else
+            echo "MISMATCH"
+        fi
+        rm "$WORKSPACE/in.txt" "$WORKSPACE/expected.txt" "$WORKSPACE/out.txt"
+    done
+done
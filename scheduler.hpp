@@ -0,0 +1,98 @@
+#pragma once
+
+#include "helpers.hpp"
+
+#include <atomic>
+#include <memory>
+
+#include <cassert>
+#include <cstdint>
+
+// Work-stealing scheduler of tasks [0, taskCount): every thread owns a
+// contiguous range of tasks packed into a single 64-bit word, takes tasks from
+// its front and, out of tasks, steals the back half of a range of other thread.
+// Both are a CAS of the word, so a range works as a lock-free deque.
+class WorkStealingScheduler
+{
+public:
+    WorkStealingScheduler(std::size_t threadCount, uint32_t taskCount)
+        : threadCount{threadCount}, ranges{new Range[threadCount]}
+    {
+        assert(threadCount != 0);
+        for (std::size_t thread = 0; thread < threadCount; ++thread) {
+            ranges[thread].tasks.store(
+                pack(uint32_t(taskCount * thread / threadCount),
+                     uint32_t(taskCount * (thread + 1) / threadCount)),
+                std::memory_order_relaxed);
+        }
+    }
+
+    // next task of thread, false if there are no tasks left to take or steal
+    bool next(std::size_t thread, uint32_t & task)
+    {
+        assert(thread < threadCount);
+        auto & tasks = ranges[thread].tasks;
+        uint64_t range = tasks.load(std::memory_order_relaxed);
+        while (begin(range) != end(range)) {
+            if (tasks.compare_exchange_weak(range,
+                                            pack(begin(range) + 1, end(range)),
+                                            std::memory_order_relaxed))
+            {
+                task = begin(range);
+                return true;
+            }
+        }
+        for (std::size_t i = 1; i < threadCount; ++i) {
+            auto & victimTasks = ranges[(thread + i) % threadCount].tasks;
+            uint64_t victimRange = victimTasks.load(std::memory_order_relaxed);
+            while (begin(victimRange) != end(victimRange)) {
+                uint32_t middle =
+                    begin(victimRange) +
+                    (end(victimRange) - begin(victimRange)) / 2;
+                if (victimTasks.compare_exchange_weak(
+                        victimRange, pack(begin(victimRange), middle),
+                        std::memory_order_relaxed))
+                {
+                    // nobody steals from the empty range of the thread
+                    tasks.store(pack(middle + 1, end(victimRange)),
+                                std::memory_order_relaxed);
+                    ++steals;
+                    task = middle;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // successful steals, for statistics
+    uint64_t getSteals() const
+    {
+        return steals.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct alignas(kHardwareDestructiveInterferenceSize) Range
+    {
+        std::atomic<uint64_t> tasks;
+    };
+
+    const std::size_t threadCount;
+    std::unique_ptr<Range[]> ranges;
+    std::atomic<uint64_t> steals = 0;
+
+    static uint64_t pack(uint32_t begin, uint32_t end)
+    {
+        return (uint64_t(end) << 32) | begin;
+    }
+
+    static uint32_t begin(uint64_t range)
+    {
+        return uint32_t(range);
+    }
+
+    static uint32_t end(uint64_t range)
+    {
+        return uint32_t(range >> 32);
+    }
+};
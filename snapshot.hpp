@@ -0,0 +1,264 @@
+#pragma once
+
+#include "memory.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Snapshot file: SnapshotHeader padded to kSnapshotHeaderSize followed by a
+// raw image of elementCount trivially copyable elements, so the file can be
+// mapped, and optionally by a kind-specific tail. Images are only valid for
+// the same build (layout, seed and table order are checked).
+constexpr uint32_t kSnapshotVersion = 1;
+constexpr std::size_t kSnapshotHeaderSize = 4096;
+
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;       // kind-specific
+    char kind[16];        // NUL-padded name of the counting engine
+    char words[16];       // NUL-padded name of the word definition
+    uint32_t seed;        // initial checksum of hashes
+    uint32_t tableOrder;  // log2 of the hash table size
+    uint64_t elementSize;
+    uint64_t elementCount;
+    uint64_t used;  // kind-specific, e.g. bytes of word arena in use
+};
+
+static_assert(std::is_trivially_copyable_v<SnapshotHeader>);
+static_assert(sizeof(SnapshotHeader) <= kSnapshotHeaderSize);
+
+inline constexpr char kSnapshotMagic[8] = {'f', 'r', 'e', 'q',
+                                           's', 'n', 'a', 'p'};
+
+inline SnapshotHeader makeSnapshotHeader(std::string_view kind,
+                                         std::string_view words, uint32_t seed,
+                                         uint32_t tableOrder, uint32_t flags,
+                                         uint64_t elementSize)
+{
+    SnapshotHeader header = {};
+    std::copy(std::cbegin(kSnapshotMagic), std::cend(kSnapshotMagic),
+              header.magic);
+    header.version = kSnapshotVersion;
+    header.flags = flags;
+    kind.copy(header.kind, sizeof header.kind - 1);
+    words.copy(header.words, sizeof header.words - 1);
+    header.seed = seed;
+    header.tableOrder = tableOrder;
+    header.elementSize = elementSize;
+    return header;
+}
+
+// all fields except elementCount and used
+inline bool checkSnapshotHeader(const SnapshotHeader & header,
+                                const SnapshotHeader & expected,
+                                std::string_view path)
+{
+    auto fail = [path](std::string_view what) {
+        fmt::print(stderr, "snapshot '{}' is incompatible: {} mismatch\n", path,
+                   what);
+        return false;
+    };
+    if (std::memcmp(header.magic, kSnapshotMagic, sizeof kSnapshotMagic) != 0) {
+        return fail("magic");
+    }
+    if (header.version != expected.version) {
+        return fail("version");
+    }
+    if (std::memcmp(header.kind, expected.kind, sizeof header.kind) != 0) {
+        return fail("kind");
+    }
+    if (std::memcmp(header.words, expected.words, sizeof header.words) != 0) {
+        return fail("word definition");
+    }
+    if (header.flags != expected.flags) {
+        return fail("flags");
+    }
+    if ((header.seed != expected.seed) ||
+        (header.tableOrder != expected.tableOrder))
+    {
+        return fail("seed or table order");
+    }
+    if (header.elementSize != expected.elementSize) {
+        return fail("layout");
+    }
+    return true;
+}
+
+template<typename T>
+struct SnapshotImage
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    static_assert((kSnapshotHeaderSize % alignof(T)) == 0);
+
+    alignas(kSnapshotHeaderSize) SnapshotHeader header;
+    alignas(kSnapshotHeaderSize) T value;
+};
+
+// Maps the snapshot of a single T privately: changes are never written back,
+// so a failed run leaves the file as it was. A missing or empty file is
+// reported by created, then the caller initializes the zero-filled value.
+template<typename T>
+MappedPtr<SnapshotImage<T>> mapSnapshot(const std::string & path,
+                                        SnapshotHeader expected, bool & created)
+{
+    using Image = SnapshotImage<T>;
+    int fd = open(path.c_str(), O_RDONLY);
+    if ((fd < 0) && (errno != ENOENT)) {
+        fmt::print(stderr, "failed to open snapshot '{}'\n", path);
+        return {nullptr, MappedDeleter{0}};
+    }
+    struct stat st = {};
+    if ((fd >= 0) && (fstat(fd, &st) != 0)) {
+        fmt::print(stderr, "failed to stat snapshot '{}'\n", path);
+        close(fd);
+        return {nullptr, MappedDeleter{0}};
+    }
+    created = (st.st_size == 0);
+    if (!created && (std::size_t(st.st_size) < sizeof(Image))) {
+        fmt::print(stderr, "snapshot '{}' is incompatible: size mismatch\n",
+                   path);
+        close(fd);
+        return {nullptr, MappedDeleter{0}};
+    }
+    void * p = created
+                   ? mmap(nullptr, sizeof(Image), PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0)
+                   : mmap(nullptr, sizeof(Image), PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE, fd, 0);
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (p == MAP_FAILED) {
+        fmt::print(stderr, "failed to map snapshot '{}'\n", path);
+        return {nullptr, MappedDeleter{0}};
+    }
+    MappedPtr<Image> image{static_cast<Image *>(p),
+                           MappedDeleter{sizeof(Image)}};
+    expected.elementCount = 1;
+    if (created) {
+        image->header = expected;
+    } else if (!checkSnapshotHeader(image->header, expected, path)) {
+        return {nullptr, MappedDeleter{0}};
+    }
+    return image;
+}
+
+// Tail of a mapped snapshot, e.g. data the image refers to: read(file) starts
+// right after the image
+template<typename T, typename Read>
+bool readSnapshotTail(const std::string & path, Read && read)
+{
+    constexpr auto kImageSize = long(sizeof(SnapshotImage<T>));
+    std::FILE * file = std::fopen(path.c_str(), "rb");
+    bool success = file && (std::fseek(file, kImageSize, SEEK_SET) == 0) &&
+                   read(file);
+    if (file) {
+        std::fclose(file);
+    }
+    return success;
+}
+
+// the image and the tail written by write(file) replace the file atomically,
+// like writeSnapshot() does
+template<typename T, typename Write>
+bool writeSnapshotImage(const std::string & path,
+                        const MappedPtr<SnapshotImage<T>> & image,
+                        Write && write)
+{
+    std::string temporaryPath = path + ".tmp";
+    std::FILE * file = std::fopen(temporaryPath.c_str(), "wb");
+    if (!file) {
+        fmt::print(stderr, "failed to open snapshot '{}' to write\n",
+                   temporaryPath);
+        return false;
+    }
+    bool success =
+        (std::fwrite(image.get(), sizeof(SnapshotImage<T>), 1, file) == 1) &&
+        write(file);
+    success = (std::fclose(file) == 0) && success;
+    if (!success ||
+        (std::rename(temporaryPath.c_str(), path.c_str()) != 0))
+    {
+        fmt::print(stderr, "failed to write snapshot '{}'\n", path);
+        return false;
+    }
+    return true;
+}
+
+// Snapshots of growing arrays are read and written as a whole, in the same
+// format. A missing file leaves elements untouched and returns true.
+template<typename T>
+bool readSnapshot(const std::string & path, const SnapshotHeader & expected,
+                  SnapshotHeader & header, std::vector<T> & elements)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    std::FILE * file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        header = expected;
+        return true;
+    }
+    bool success = false;
+    if (std::fread(&header, sizeof header, 1, file) != 1) {
+        fmt::print(stderr, "failed to read snapshot '{}' header\n", path);
+    } else if (checkSnapshotHeader(header, expected, path)) {
+        elements.resize(header.elementCount);
+        if ((std::fseek(file, long(kSnapshotHeaderSize), SEEK_SET) != 0) ||
+            (std::fread(elements.data(), sizeof(T), elements.size(), file) !=
+             elements.size()))
+        {
+            fmt::print(stderr, "failed to read snapshot '{}'\n", path);
+        } else {
+            success = true;
+        }
+    }
+    std::fclose(file);
+    return success;
+}
+
+// the file is replaced atomically
+template<typename T>
+bool writeSnapshot(const std::string & path, SnapshotHeader header,
+                   const std::vector<T> & elements)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    header.elementCount = elements.size();
+    std::string temporaryPath = path + ".tmp";
+    std::FILE * file = std::fopen(temporaryPath.c_str(), "wb");
+    if (!file) {
+        fmt::print(stderr, "failed to open snapshot '{}' to write\n",
+                   temporaryPath);
+        return false;
+    }
+    char headerBlock[kSnapshotHeaderSize] = {};
+    std::memcpy(headerBlock, &header, sizeof header);
+    bool success =
+        (std::fwrite(headerBlock, sizeof headerBlock, 1, file) == 1) &&
+        (std::fwrite(elements.data(), sizeof(T), elements.size(), file) ==
+         elements.size());
+    success = (std::fclose(file) == 0) && success;
+    if (!success ||
+        (std::rename(temporaryPath.c_str(), path.c_str()) != 0))
+    {
+        fmt::print(stderr, "failed to write snapshot '{}'\n", path);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,153 @@
+#include "charclass.hpp"
+#include "helpers.hpp"
+#include "io.hpp"
+#include "options.hpp"
+#include "spacesaving.hpp"
+#include "timer.hpp"
+#include "tokenizer.hpp"
+
+#include <fmt/color.h>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+constexpr uint32_t kInitialChecksum = 0;
+
+}  // namespace
+
+// Approximate counting of streams of any size in memory of capacity counters:
+// input is read by blocks, the hashes of words from tokenize() feed a
+// Space-Saving summary
+int main(int argc, char * argv[])
+{
+    Timer timer{fmt::format(fg(fmt::color::dark_green), "total")};
+
+    Options options{argc, argv};
+    const auto & positional = options.getPositional();
+    if (positional.size() != 2) {
+        fmt::print(stderr,
+                   "usage: {} [--capacity=65536] [--top=100] in.txt out.txt\n"
+                   "output lines are 'count error word', the true count of "
+                   "word is in [count - error, count]\n",
+                   argv[0]);
+        return EXIT_FAILURE;
+    }
+    std::size_t capacity = 1 << 16;
+    std::size_t top = 100;
+    if (!options.get("capacity", capacity) || !options.get("top", top)) {
+        return EXIT_FAILURE;
+    }
+    if ((capacity == 0) || (capacity > (std::size_t(1) << 30))) {
+        fmt::print(stderr, "--capacity should be in range 1..2^30\n");
+        return EXIT_FAILURE;
+    }
+
+    using namespace std::string_view_literals;
+
+    auto inputFile = (positional[0] == "-"sv)
+                         ? wrapFile(stdin)
+                         : openFile(positional[0].data(), "rb");
+    if (!inputFile) {
+        fmt::print(stderr, "failed to open '{}' file to read\n",
+                   positional[0]);
+        return EXIT_FAILURE;
+    }
+
+    auto outputFile = (positional[1] == "-"sv)
+                          ? wrapFile(stdout)
+                          : openFile(positional[1].data(), "wb");
+    if (!outputFile) {
+        fmt::print(stderr, "failed to open '{}' file to write\n",
+                   positional[1]);
+        return EXIT_FAILURE;
+    }
+
+    SpaceSaving spaceSaving{capacity};
+    {
+        AsyncReader reader{inputFile};
+        uint32_t hash = kInitialChecksum;
+        uint32_t len = 0;
+        auto onWord = [&spaceSaving](uint32_t hash, const char * wordEnd,
+                                     uint32_t len) {
+            spaceSaving.add(hash, {std::prev(wordEnd, len), len});
+        };
+        while (reader.next(len)) {
+            toLower<charclass::Alpha>(reader.begin(), reader.end());
+            tokenize</* kInputIsLowercase */ true>(
+                reader.begin(), reader.end(), kInitialChecksum, hash, len,
+                onWord);
+        }
+        if (reader.isFailed()) {
+            return EXIT_FAILURE;
+        }
+        fmt::print(stderr, "input size = {} bytes\n", reader.getReadSize());
+    }
+    timer.report(fmt::format(fg(fmt::color::dark_blue), "count words"));
+
+    fmt::print(stderr, "stream = {} words, {} counters, overestimation <= {}\n",
+               spaceSaving.getStreamLength(), spaceSaving.getCapacity(),
+               spaceSaving.getMinCount());
+
+    std::vector<std::tuple<uint64_t, uint64_t, std::string_view>> rank;
+    rank.reserve(spaceSaving.getCounters().size());
+    for (const auto & [count, error, word, hash] : spaceSaving.getCounters()) {
+        rank.emplace_back(count, error, word);
+    }
+    auto rankLess = [](const auto & lhs, const auto & rhs) {
+        return std::tie(std::get<0>(rhs), std::get<2>(lhs)) <
+               std::tie(std::get<0>(lhs), std::get<2>(rhs));
+    };
+    top = std::min(top, rank.size());
+    std::partial_sort(std::begin(rank), std::next(std::begin(rank), top),
+                      std::end(rank), rankLess);
+    // unmonitored words occur at most getMinCount() times
+    uint64_t restCount = spaceSaving.getMinCount();
+    for (auto i = std::next(std::cbegin(rank), top); i != std::cend(rank);
+         ++i)
+    {
+        restCount = std::max(restCount, std::get<0>(*i));
+    }
+    rank.resize(top);
+    timer.report(fmt::format(fg(fmt::color::dark_orange), "sort words"));
+
+    // words of a guaranteed prefix are the true top ones: each of them occurs
+    // at least as often as estimated for any word after the prefix
+    std::size_t guaranteed = 0;
+    uint64_t minLowerBound = std::numeric_limits<uint64_t>::max();
+    for (std::size_t i = 0; i < rank.size(); ++i) {
+        const auto & [count, error, word] = rank[i];
+        minLowerBound = std::min(minLowerBound, count - error);
+        uint64_t nextCount = ((i + 1) < rank.size())
+                                 ? std::get<0>(rank[i + 1])
+                                 : restCount;
+        if (minLowerBound >= nextCount) {
+            guaranteed = i + 1;
+        }
+    }
+    fmt::print(stderr, "guaranteed top = {} of {}\n", guaranteed, rank.size());
+
+    OutputStream<> outputStream{outputFile};
+    for (const auto & [count, error, word] : rank) {
+        if (!outputStream.print(count) || !outputStream.putChar(' ') ||
+            !outputStream.print(error) || !outputStream.putChar(' ') ||
+            !outputStream.print(word) || !outputStream.putChar('\n'))
+        {
+            fmt::print(stderr, "output failure\n");
+            return EXIT_FAILURE;
+        }
+    }
+    timer.report("write output");
+
+    return EXIT_SUCCESS;
+}
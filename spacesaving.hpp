@@ -0,0 +1,193 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <cassert>
+#include <cstdint>
+
+// Space-Saving summary of a stream of words (Metwally, Agrawal, El Abbadi):
+// capacity counters monitor words, an unmonitored word takes over the counter
+// of the least count and inherits that count as its error. A count is at most
+// by error greater than the true count of the word, which is at most by
+// getMinCount() greater than the true count of any unmonitored word, and
+// getMinCount() is at most getStreamLength() / capacity. Counters are kept in
+// a binary min-heap by count and found by the hashes of their words in an
+// open addressing index, words are verified.
+class SpaceSaving
+{
+public:
+    struct Counter
+    {
+        uint64_t count;
+        uint64_t error;  // the true count is in [count - error, count]
+        std::string word;
+        uint32_t hash;
+    };
+
+    explicit SpaceSaving(std::size_t capacity)
+        : capacity{std::max<std::size_t>(capacity, 1)},
+          index(std::bit_ceil(2 * this->capacity), 0)
+    {
+        counters.reserve(this->capacity);
+        heap.reserve(this->capacity);
+        positions.reserve(this->capacity);
+    }
+
+    void add(uint32_t hash, std::string_view word)
+    {
+        ++streamLength;
+        std::size_t slot = find(hash, word);
+        if (index[slot] != 0) {
+            uint32_t counter = index[slot] - 1;
+            ++counters[counter].count;
+            ++heap[positions[counter]].count;
+            siftDown(positions[counter]);
+            return;
+        }
+        if (counters.size() < capacity) {
+            auto counter = uint32_t(counters.size());
+            counters.push_back({1, 0, std::string{word}, hash});
+            index[slot] = counter + 1;
+            positions.push_back(uint32_t(heap.size()));
+            heap.push_back({1, counter});
+            siftUp(heap.size() - 1);
+            return;
+        }
+        uint32_t counter = heap.front().counter;
+        Counter & minCounter = counters[counter];
+        erase(find(minCounter.hash, minCounter.word));
+        index[find(hash, word)] = counter + 1;
+        minCounter.error = minCounter.count;
+        ++minCounter.count;
+        minCounter.word.assign(word);  // reuses the storage of the old word
+        minCounter.hash = hash;
+        ++heap.front().count;
+        siftDown(0);
+    }
+
+    // counters in unspecified order
+    const std::vector<Counter> & getCounters() const
+    {
+        return counters;
+    }
+
+    // 0 until all counters are taken
+    uint64_t getMinCount() const
+    {
+        if (counters.size() < capacity) {
+            return 0;
+        }
+        return heap.front().count;
+    }
+
+    uint64_t getStreamLength() const
+    {
+        return streamLength;
+    }
+
+    std::size_t getCapacity() const
+    {
+        return capacity;
+    }
+
+private:
+    // counts are duplicated, so that sifting does not touch counters
+    struct HeapEntry
+    {
+        uint64_t count;
+        uint32_t counter;
+    };
+
+    std::size_t capacity;
+    std::vector<Counter> counters;
+    std::vector<HeapEntry> heap;      // min-heap by count
+    std::vector<uint32_t> positions;  // in heap, of counters
+    std::vector<uint32_t> index;      // counter + 1 by hash, 0 for empty slots
+    uint64_t streamLength = 0;
+
+    std::size_t getMask() const
+    {
+        return index.size() - 1;
+    }
+
+    // the slot of the word or the empty slot it should be inserted into
+    std::size_t find(uint32_t hash, std::string_view word) const
+    {
+        std::size_t mask = getMask();
+        for (std::size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+            uint32_t counter = index[slot];
+            if (counter == 0) {
+                return slot;
+            }
+            const Counter & c = counters[counter - 1];
+            if ((c.hash == hash) && (c.word == word)) {
+                return slot;
+            }
+        }
+    }
+
+    // backward shift deletion, so that probe sequences stay without holes
+    void erase(std::size_t slot)
+    {
+        assert(index[slot] != 0);
+        std::size_t mask = getMask();
+        for (std::size_t next = (slot + 1) & mask; index[next] != 0;
+             next = (next + 1) & mask)
+        {
+            std::size_t home = counters[index[next] - 1].hash & mask;
+            // the entry of next may move to slot unless its home is in
+            // (slot, next] cyclically
+            if (((next - home) & mask) >= ((next - slot) & mask)) {
+                index[slot] = index[next];
+                slot = next;
+            }
+        }
+        index[slot] = 0;
+    }
+
+    void swap(std::size_t lhs, std::size_t rhs)
+    {
+        std::swap(heap[lhs], heap[rhs]);
+        positions[heap[lhs].counter] = uint32_t(lhs);
+        positions[heap[rhs].counter] = uint32_t(rhs);
+    }
+
+    void siftUp(std::size_t position)
+    {
+        while (position != 0) {
+            std::size_t parent = (position - 1) / 2;
+            if (!(heap[position].count < heap[parent].count)) {
+                break;
+            }
+            swap(position, parent);
+            position = parent;
+        }
+    }
+
+    // counts only grow, hot words settle at leaves and stay there
+    void siftDown(std::size_t position)
+    {
+        for (;;) {
+            std::size_t child = 2 * position + 1;
+            if (child >= heap.size()) {
+                break;
+            }
+            if (((child + 1) < heap.size()) &&
+                (heap[child + 1].count < heap[child].count))
+            {
+                ++child;
+            }
+            if (!(heap[child].count < heap[position].count)) {
+                break;
+            }
+            swap(position, child);
+            position = child;
+        }
+    }
+};
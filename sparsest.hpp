@@ -0,0 +1,232 @@
+#pragma once
+
+#include "arena.hpp"
+#include "helpers.hpp"
+#include "tokenizer.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include <cstdint>
+#include <cstdio>
+
+#include <unistd.h>
+
+// Sparsest possible hash table: counters are addressed by full CRC32 of a word
+// directly, only touched pages of 12 GiB arrays are backed by memory
+namespace sparsest
+{
+
+// perfect hash seeds 8, 23, 89, 126, 181, 331, 381, 507, ...
+constexpr uint32_t kInitialChecksum = 23;
+
+#pragma pack(push, 1)
+struct uint24
+{
+    unsigned long long int value : 24;
+
+    uint24 operator++(int) &
+    {
+        auto temp = *this;
+        ++value;
+        return temp;
+    }
+
+    operator uint32_t() const
+    {
+        return value;
+    }
+};
+#pragma pack(pop)
+
+static_assert(sizeof(uint24) == 3);
+
+constexpr uint32_t kMaxCount = (uint32_t(1) << 24) - 1;
+
+// Multiples of kMaxCount carried out of saturated counters, addressed by hash
+// with linear probing: only words occurring 2^24 times and more are here
+struct SpillTable
+{
+    struct Spill
+    {
+        uint64_t count;
+        uint32_t hash;
+        bool used;
+    };
+
+    static constexpr std::size_t kCapacity = std::size_t(1) << 16;
+
+    Spill spills[kCapacity];
+    std::size_t size;
+    bool full;  // a spill was lost
+
+    void add(uint32_t hash, uint64_t count)
+    {
+        Spill * spill = find(hash);
+        if (!spill->used) {
+            if UNLIKELY (size + 1 == kCapacity) {  // keep one slot empty
+                full = true;
+                return;
+            }
+            ++size;
+            spill->hash = hash;
+            spill->used = true;
+        }
+        spill->count += count;
+    }
+
+    uint64_t get(uint32_t hash) const
+    {
+        return const_cast<SpillTable *>(this)->find(hash)->count;
+    }
+
+private:
+    Spill * find(uint32_t hash)
+    {
+        for (auto i = hash % kCapacity;; i = (i + 1) % kCapacity) {
+            if (!spills[i].used || (spills[i].hash == hash)) {
+                return &spills[i];
+            }
+        }
+    }
+};
+
+constexpr std::size_t kPageSize = 4096;
+
+// requires -mcmodel=medium for static storage or mapZeroed() otherwise
+struct HashTable
+{
+    alignas(kPageSize)
+        uint24 counts[std::size_t(std::numeric_limits<uint32_t>::max()) + 1];
+
+    // references fit into uint24, thus 256 MiB of words at most
+    WordArena<24> arena;
+
+    SpillTable spillTable;
+
+    alignas(kHardwareDestructiveInterferenceSize)
+        uint24 words[std::size_t(std::numeric_limits<uint32_t>::max()) + 1];
+
+    void init()
+    {
+        arena.release();  // words of the previous init(), if any
+        arena.init();
+    }
+
+    void incCounter(uint32_t hash, const char * __restrict wordEnd,
+                    uint32_t len)
+    {
+        uint24 & count = counts[hash];
+        if UNLIKELY (count.value == 0) {
+            words[hash].value = arena.append(std::prev(wordEnd, len), len);
+        } else if UNLIKELY (count.value == kMaxCount) {
+            spillTable.add(hash, kMaxCount);
+            count.value = 0;
+        }
+        ++count.value;
+    }
+
+    uint64_t getCount(uint32_t hash) const
+    {
+        return counts[hash] + spillTable.get(hash);
+    }
+
+    // onWord(count, word) for every counted word, word is a reference in
+    // arena; only pages of counts present in /proc/self/pagemap are scanned,
+    // false if it is not available
+    template<typename OnWord>
+    bool forEachWord(OnWord && onWord) const
+    {
+        auto onHash = [this, &onWord](std::size_t hash) {
+            if (counts[hash] != 0) {
+                onWord(getCount(uint32_t(hash)), uint32_t(words[hash].value));
+            }
+        };
+        if ((false)) {
+            for (std::size_t i = 0; i < std::extent_v<decltype(counts)>; ++i)
+            {
+                onHash(i);
+            }
+            return true;
+        }
+
+        if (std::size_t(getpagesize()) != kPageSize) {
+            return false;
+        }
+        std::unique_ptr<std::FILE, int (*)(std::FILE *)> pagemapFile{
+            std::fopen("/proc/self/pagemap", "rb"), std::fclose};
+        if (!pagemapFile) {
+            return false;
+        }
+
+        using PmEntry = uint64_t;
+        constexpr std::size_t kPmPresent = 1ULL << 63;
+
+        auto lowerAddress = reinterpret_cast<std::uintptr_t>(counts + 0);
+        auto upperAddress = lowerAddress + sizeof counts;
+        if (fseeko64(pagemapFile.get(),
+                     sizeof(PmEntry) * (lowerAddress / kPageSize),
+                     SEEK_SET) != 0)
+        {
+            return false;
+        }
+        std::vector<PmEntry> pagemap((upperAddress + kPageSize - 1) /
+                                         kPageSize -
+                                     lowerAddress / kPageSize);
+        std::size_t readSize = std::fread(pagemap.data(), sizeof pagemap.back(),
+                                          pagemap.size(), pagemapFile.get());
+        if (readSize != pagemap.size()) {
+            return false;
+        }
+
+        auto isPagePresent = [](const PmEntry & entry) {
+            return (entry & kPmPresent) != 0;
+        };
+        auto hi = std::cbegin(pagemap);
+        for (;;) {
+            auto lo = std::find_if(hi, std::cend(pagemap), isPagePresent);
+            if (lo == std::cend(pagemap)) {
+                break;
+            }
+            hi = std::find_if_not(lo, std::cend(pagemap), isPagePresent);
+            auto l = (std::distance(std::cbegin(pagemap), lo) * kPageSize +
+                      sizeof counts[0] - 1) /
+                     sizeof counts[0];
+            auto r = (std::distance(std::cbegin(pagemap), hi) * kPageSize) /
+                     sizeof counts[0];
+            for (auto i = l; i != r; ++i) {
+                onHash(i);
+            }
+        }
+        return true;
+    }
+
+    void countWords(const char * beg, const char * end)
+    {
+        uint32_t hash = kInitialChecksum;
+        uint32_t len = 0;
+        auto onWord = [this](uint32_t hash, const char * wordEnd,
+                             uint32_t len) { incCounter(hash, wordEnd, len); };
+        tokenize<false>(beg, end, kInitialChecksum, hash, len, onWord);
+        if (len != 0) {
+            incCounter(hash, end, len);
+        }
+    }
+
+    // countWords() for consecutive blocks of a stream: a word which is not
+    // finished at end is left in hash and len (initially kInitialChecksum and
+    // 0), its bytes should precede the next block (see AsyncReader)
+    void countWords(const char * beg, const char * end, uint32_t & hash,
+                    uint32_t & len)
+    {
+        auto onWord = [this](uint32_t hash, const char * wordEnd,
+                             uint32_t len) { incCounter(hash, wordEnd, len); };
+        tokenize<false>(beg, end, kInitialChecksum, hash, len, onWord);
+    }
+};
+
+}  // namespace sparsest
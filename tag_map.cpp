@@ -0,0 +1,7 @@
+#include "common.hpp"
+#include "tag_map.hpp"
+
+int main(int argc, char * argv[])
+{
+    return countWords<TagMap>(argc, argv);
+}
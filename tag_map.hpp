@@ -0,0 +1,233 @@
+#pragma once
+
+#include "helpers.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <cstdint>
+#include <cstring>
+
+// General-purpose string-keyed map of the design of oaph::HashTable: groups of
+// 8 slots addressed by the low bits of CRC32 of a key are probed linearly, a
+// slot is a 15-bit tag of the hash, so that a group is matched by a single SSE
+// comparison, and an index of an entry. Entries are stored in the order of
+// insertion, keys are copied into an arena of blocks and verified. Erasure is
+// not supported, references and iterators are invalidated by an insertion,
+// while keys of entries stay in place.
+template<typename Key, typename Value>
+class TagMap
+{
+    static_assert(std::is_same_v<Key, std::string_view>, "string keys only");
+
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = std::pair<Key, Value>;
+    using iterator = typename std::vector<value_type>::iterator;
+    using const_iterator = typename std::vector<value_type>::const_iterator;
+
+    static constexpr std::size_t kGroupSize =
+        sizeof(__m128i) / sizeof(uint16_t);
+
+    TagMap()
+    {
+        rehash(1);
+    }
+
+    Value & operator[](Key key)
+    {
+        uint32_t hash = getHash(key);
+        auto [group, index] = find(key, hash);
+        if (index < kGroupSize) {
+            return entries[groups[group].entries[index]].second;
+        }
+        if ((entries.size() + 1) > getGroupCount() * kGroupSize / 8 * 7) {
+            rehash(getGroupCount() * 2);
+            std::tie(group, index) = find(key, hash);
+        }
+        insert(group, hash, uint32_t(entries.size()));
+        entries.emplace_back(storeKey(key), Value{});
+        hashes.push_back(hash);
+        return entries.back().second;
+    }
+
+    iterator find(Key key)
+    {
+        auto [group, index] = find(key, getHash(key));
+        if (index < kGroupSize) {
+            return std::next(std::begin(entries),
+                             groups[group].entries[index]);
+        }
+        return std::end(entries);
+    }
+
+    void reserve(std::size_t size)
+    {
+        entries.reserve(size);
+        hashes.reserve(size);
+        std::size_t groupCount = getGroupCount();
+        while ((groupCount * kGroupSize / 8 * 7) < size) {
+            groupCount *= 2;
+        }
+        if (groupCount != getGroupCount()) {
+            rehash(groupCount);
+        }
+    }
+
+    std::size_t size() const
+    {
+        return entries.size();
+    }
+
+    bool empty() const
+    {
+        return entries.empty();
+    }
+
+    iterator begin()
+    {
+        return std::begin(entries);
+    }
+
+    iterator end()
+    {
+        return std::end(entries);
+    }
+
+    const_iterator begin() const
+    {
+        return std::cbegin(entries);
+    }
+
+    const_iterator end() const
+    {
+        return std::cend(entries);
+    }
+
+private:
+    static constexpr uint16_t kEmptyTag = 0xFFFF;  // tags are 15-bit
+    static constexpr std::size_t kBlockSize = std::size_t(1) << 16;
+
+    struct Group
+    {
+        __m128i tags;
+        uint32_t entries[kGroupSize];
+    };
+
+    std::vector<Group> groups;
+    std::vector<value_type> entries;
+    std::vector<uint32_t> hashes;  // of entries, for rehash()
+    std::vector<std::unique_ptr<char[]>> blocks;  // arena of keys
+    char * blockTop = nullptr;  // free bytes of the last block
+    std::size_t blockSpace = 0;
+
+    std::size_t getGroupCount() const
+    {
+        return groups.size();
+    }
+
+    static uint32_t getHash(Key key)
+    {
+        uint64_t hash = 0;
+        auto data = key.data();
+        auto size = key.size();
+        for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t)) {
+            uint64_t word;
+            std::memcpy(&word, data, sizeof word);
+            hash = _mm_crc32_u64(hash, word);
+            data = std::next(data, sizeof word);
+        }
+        for (; size != 0; --size) {
+            hash = _mm_crc32_u8(uint32_t(hash), uint8_t(*data++));
+        }
+        return uint32_t(hash);
+    }
+
+    // the tag is taken from the finalizer of MurmurHash3, so that it does not
+    // repeat the bits addressing the group
+    static uint16_t getTag(uint32_t hash)
+    {
+        hash ^= hash >> 16;
+        hash *= 0x85EBCA6Bu;
+        hash ^= hash >> 13;
+        hash *= 0xC2B2AE35u;
+        hash ^= hash >> 16;
+        return uint16_t(hash >> 17);
+    }
+
+    // the group and the slot of the key, or the group with the first empty
+    // slot to insert it into and kGroupSize
+    std::pair<std::size_t, std::size_t> find(Key key, uint32_t hash) const
+    {
+        std::size_t mask = getGroupCount() - 1;
+        std::size_t group = hash & mask;
+        __m128i tag = _mm_set1_epi16(int16_t(getTag(hash)));
+        for (;;) {
+            __m128i groupTags = _mm_load_si128(&groups[group].tags);
+            auto m = uint32_t(
+                _mm_movemask_epi8(_mm_cmpeq_epi16(groupTags, tag)));
+            while (m != 0) {
+                unsigned long index;
+                BSF(index, m);
+                if (entries[groups[group].entries[index / 2]].first == key) {
+                    return {group, index / 2};
+                }
+                m &= m - 1;
+                m &= m - 1;  // two bits per 16-bit tag
+            }
+            if ((_mm_movemask_epi8(groupTags) & 0b1010101010101010) != 0) {
+                return {group, kGroupSize};
+            }
+            group = (group + 1) & mask;  // linear probing
+        }
+    }
+
+    void insert(std::size_t group, uint32_t hash, uint32_t entry)
+    {
+        std::size_t mask = getGroupCount() - 1;
+        for (;; group = (group + 1) & mask) {
+            auto m = uint32_t(_mm_movemask_epi8(groups[group].tags)) &
+                     0b1010101010101010u;
+            if (m != 0) {
+                unsigned long index;
+                BSF(index, m);
+                index /= 2;
+                reinterpret_cast<uint16_t *>(&groups[group].tags)[index] =
+                    getTag(hash);
+                groups[group].entries[index] = entry;
+                return;
+            }
+        }
+    }
+
+    void rehash(std::size_t groupCount)
+    {
+        groups.assign(groupCount, {_mm_set1_epi16(int16_t(kEmptyTag)), {}});
+        std::size_t mask = groupCount - 1;
+        for (std::size_t entry = 0; entry < hashes.size(); ++entry) {
+            insert(hashes[entry] & mask, hashes[entry], uint32_t(entry));
+        }
+    }
+
+    Key storeKey(Key key)
+    {
+        if (key.size() > blockSpace) {
+            std::size_t blockSize = std::max(kBlockSize, key.size());
+            blocks.emplace_back(new char[blockSize]);
+            blockTop = blocks.back().get();
+            blockSpace = blockSize;
+        }
+        char * data = blockTop;
+        std::copy(std::cbegin(key), std::cend(key), data);
+        blockTop = std::next(blockTop, std::ptrdiff_t(key.size()));
+        blockSpace -= key.size();
+        return {data, key.size()};
+    }
+};
@@ -0,0 +1,55 @@
+#! /usr/bin/bash
+
+set -ueo pipefail
+
+if [[ ! $# -ge 2 || ! -x $1 || ! -x $2 ]]
+then
+    >&2 echo "Usage: bash threads.bash PATH_TO_OAPH PATH_TO_GENERATE [THREADS [SIZE [VOCABULARY [ZIPF]]]]"
+    exit 2
+fi
+
+EXECUTABLE="$( realpath "$1" )"
+GENERATE="$( realpath "$2" )"
+THREADS="${3:-1 2 4 8 16 32 64}"
+SIZE="${4:-256M}"
+VOCABULARY="${5:-100000}"
+ZIPF="${6:-1.0}"
+
+if ! WORKSPACE="$( mktemp -d --tmpdir 'freq.XXXXXX' )"
+then
+    >&2 echo "Unable to create temporary directory"
+    exit 6
+fi
+trap 'rm -r "$WORKSPACE"' EXIT
+
+# Note: per-thread tables and the shared table are compared on the same word
+# definition with a key comparison, because CRC seeds are perfect for pg.txt only
+"$GENERATE" --size="$SIZE" --vocabulary="$VOCABULARY" --zipf="$ZIPF" \
+    --capitalized=0.1 --punctuation=0.1 \
+    "$WORKSPACE/in.txt" "$WORKSPACE/expected.txt" 2>/dev/null
+mkdir "$WORKSPACE/in"
+split --line-bytes=4M "$WORKSPACE/in.txt" "$WORKSPACE/in/"
+rm "$WORKSPACE/in.txt" "$WORKSPACE/expected.txt"
+echo "size $SIZE vocabulary $VOCABULARY zipf $ZIPF"
+for THREAD_COUNT in $THREADS
+do
+    for MODE in per-thread shared
+    do
+        echo "threads $THREAD_COUNT $MODE"
+        OPTIONS=( --words=apostrophe )
+        if [[ $MODE == shared ]]
+        then
+            OPTIONS+=( --shared )
+        fi
+        OMP_NUM_THREADS="$THREAD_COUNT" LC_ALL=C "$EXECUTABLE" "${OPTIONS[@]}" \
+            "$WORKSPACE/in" "$WORKSPACE/$MODE.txt" 2>&1 \
+            | grep -E '^(time|memory) \(.*(count words|merge thread hashTables|total)'
+    done
+    if cmp --quiet "$WORKSPACE/per-thread.txt" "$WORKSPACE/shared.txt"
+    then
+        echo "OK"
+    else
+        echo "MISMATCH"
+    fi
+    rm "$WORKSPACE/per-thread.txt" "$WORKSPACE/shared.txt"
+done
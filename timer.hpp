@@ -1,10 +1,13 @@
 #pragma once
 
+#include "memory.hpp"
+
 #include <fmt/format.h>
 
 #include <chrono>
 #include <string>
 #include <string_view>
+#include <type_traits>
 #include <utility>
 
 #include <cstdio>
@@ -15,6 +18,8 @@ struct Timer
     const std::chrono::steady_clock::time_point start =
         std::chrono::steady_clock::now();
     std::chrono::steady_clock::time_point timePoint = start;
+    const MemoryUsage startMemoryUsage = MemoryUsage::current();
+    MemoryUsage memoryUsage = startMemoryUsage;
 
     auto dt(bool absolute = false)
     {
@@ -25,9 +30,31 @@ struct Timer
                1E-9;
     }
 
+    MemoryUsage dm(bool absolute = false)
+    {
+        auto current = MemoryUsage::current();
+        const auto & previous =
+            absolute ? startMemoryUsage : std::exchange(memoryUsage, current);
+        return {
+            .rss = current.rss - previous.rss,
+            .peakRss = current.peakRss,
+            .minorFaults = current.minorFaults - previous.minorFaults,
+            .majorFaults = current.majorFaults - previous.majorFaults,
+        };
+    }
+
     void report(std::string_view description, bool absolute = false)
     {
         fmt::print(stderr, "time ({}) = {:.3}\n", description, dt(absolute));
+        auto delta = dm(absolute);
+        constexpr double kMiB = 1 << 20;
+        fmt::print(stderr,
+                   "memory ({}) = rss {:+.1f} MiB, peak rss {:.1f} MiB, "
+                   "page faults {} minor / {} major\n",
+                   description,
+                   double(std::make_signed_t<std::size_t>(delta.rss)) / kMiB,
+                   double(delta.peakRss) / kMiB, delta.minorFaults,
+                   delta.majorFaults);
     }
 
     ~Timer()
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "charclass.hpp"
+#include "helpers.hpp"
+
+#include <iterator>
+
+#include <cassert>
+#include <cstdint>
+
+// Splits [beg, end) into words and calls onWord(hash, wordEnd, len) for each
+// of them, where hash is CRC32 of lowercase word seeded with initialChecksum.
+// If kInputIsLowercase, then input is expected to be preprocessed by toLower()
+// (of the same CharClass) and words are runs of non-NUL bytes, otherwise words
+// are defined by CharClass (see charclass.hpp).
+// A word which is not finished at end is left in hash and len, so the caller
+// can either continue it in the next call or finish it by itself.
+template<bool kInputIsLowercase, typename CharClass = charclass::Alpha,
+         typename OnWord>
+FORCEINLINE inline void tokenize(const char * beg, const char * end,
+                                 uint32_t initialChecksum, uint32_t & hash,
+                                 uint32_t & len, OnWord && onWord)
+{
+    assert((reinterpret_cast<std::uintptr_t>(beg) % sizeof(__m128i)) == 0);
+    [[maybe_unused]] charclass::Classifier<CharClass> classify;
+    for (auto i = beg; LIKELY(i < end); i += sizeof(__m128i)) {
+        __m128i str = _mm_load_si128(reinterpret_cast<const __m128i *>(i));
+        uint16_t m;
+        if (kInputIsLowercase) {
+            m = uint16_t(
+                _mm_movemask_epi8(_mm_cmpeq_epi8(str, _mm_setzero_si128())));
+        } else {
+            m = uint16_t(classify(str, str, i, end));
+        }
+        // clang-format off
+#define BYTE(offset)                                                           \
+        if UNPREDICTABLE ((m & (uint32_t(1) << offset)) == 0) {                \
+            ++len;                                                             \
+            hash = _mm_crc32_u8(hash, uint8_t(_mm_extract_epi8(str, offset))); \
+        } else if UNPREDICTABLE (len != 0) {                                   \
+            onWord(hash, std::next(i, offset), len);                           \
+            len = 0;                                                           \
+            hash = initialChecksum;                                            \
+        }
+
+        BYTE(0)
+        BYTE(1)
+        BYTE(2)
+        BYTE(3)
+        BYTE(4)
+        BYTE(5)
+        BYTE(6)
+        BYTE(7)
+        BYTE(8)
+        BYTE(9)
+        BYTE(10)
+        BYTE(11)
+        BYTE(12)
+        BYTE(13)
+        BYTE(14)
+        BYTE(15)
+#undef BYTE
+        // clang-format on
+    }
+}
+
+// Calls onWord(hash, wordEnd, len) for every word of [inputBeg, inputEnd)
+// which starts in the task [beg, end): a word straddling beg belongs to the
+// previous task, a word straddling end is finished byte by byte, so tasks at
+// arbitrary 16-byte aligned bounds count every word once
+template<bool kInputIsLowercase, typename CharClass = charclass::Alpha,
+         typename OnWord>
+inline void tokenizeTask(const char * inputBeg, const char * beg,
+                         const char * end, const char * inputEnd,
+                         uint32_t initialChecksum, OnWord && onWord)
+{
+    static_assert(kInputIsLowercase || !charclass::kHasInner<CharClass>,
+                  "inner bytes can't be resolved at task bounds");
+    assert((inputBeg <= beg) && (beg <= end) && (end <= inputEnd));
+    auto isWord = [](char c) {
+        if (kInputIsLowercase) {
+            return c != '\0';
+        } else {
+            return (charclass::kTable<CharClass>[uint8_t(c)] &
+                    charclass::kWord) != 0;
+        }
+    };
+    const char * straddling =
+        ((beg != inputBeg) && isWord(*std::prev(beg))) ? beg : nullptr;
+    auto onTaskWord = [&](uint32_t hash, const char * wordEnd, uint32_t len) {
+        if (std::prev(wordEnd, len) != straddling) {
+            onWord(hash, wordEnd, len);
+        }
+    };
+    uint32_t hash = initialChecksum;
+    uint32_t len = 0;
+    tokenize<kInputIsLowercase, CharClass>(beg, end, initialChecksum, hash, len,
+                                           onTaskWord);
+    if (len != 0) {
+        for (; (end != inputEnd) && isWord(*end); ++end) {
+            ++len;
+            hash = _mm_crc32_u8(hash, charclass::toLowerAscii(uint8_t(*end)));
+        }
+        onTaskWord(hash, end, len);
+    }
+}
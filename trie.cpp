@@ -1,6 +1,11 @@
 #include "helpers.hpp"
 #include "io.hpp"
+#include "options.hpp"
+#include "partial.hpp"
+#include "rank.hpp"
+#include "snapshot.hpp"
 #include "timer.hpp"
+#include "trie.hpp"
 
 #include <fmt/color.h>
 #include <fmt/format.h>
@@ -9,11 +14,11 @@
 #include <chrono>
 #include <iterator>
 #include <memory>
+#include <string>
 #include <string_view>
 #include <utility>
 #include <vector>
 
-#include <cassert>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
@@ -21,16 +26,10 @@
 namespace
 {
 
-constexpr std::size_t kAlphabetSize = 'z' - 'a' + 1;
-
 alignas(__m128i) char input[1 << 29];
 auto inputEnd = input;
 
-struct TrieNode
-{
-    uint32_t count = 0;
-    uint32_t children[kAlphabetSize] = {};
-};
+using trie::TrieNode;
 
 }  // namespace
 
@@ -38,95 +37,123 @@ int main(int argc, char * argv[])
 {
     Timer timer{fmt::format(fg(fmt::color::dark_green), "total")};
 
-    if (argc != 3) {
-        fmt::print(stderr, "usage: {} in.txt out.txt\n", argv[0]);
+    Options options{argc, argv};
+    const auto & positional = options.getPositional();
+    if (positional.size() != 2) {
+        fmt::print(stderr,
+                   "usage: {} [--snapshot=counts.snapshot] [--partial] in.txt "
+                   "out.txt\n",
+                   argv[0]);
         return EXIT_FAILURE;
     }
+    // counts of previous runs are accumulated in it
+    std::string snapshotPath{options.get("snapshot")};
+    // output is a partial result for freq-merge
+    bool partial = options.has("partial");
 
     using namespace std::string_view_literals;
 
-    auto inputFile =
-        (argv[1] == "-"sv) ? wrapFile(stdin) : openFile(argv[1], "rb");
+    // positional arguments are whole argv[] entries, hence NUL-terminated
+    auto inputFile = (positional[0] == "-"sv)
+                         ? wrapFile(stdin)
+                         : openFile(positional[0].data(), "rb");
     if (!inputFile) {
-        fmt::print(stderr, "failed to open '{}' file to read\n", argv[1]);
+        fmt::print(stderr, "failed to open '{}' file to read\n", positional[0]);
         return EXIT_FAILURE;
     }
 
-    auto outputFile =
-        (argv[2] == "-"sv) ? wrapFile(stdout) : openFile(argv[2], "wb");
+    auto outputFile = (positional[1] == "-"sv)
+                          ? wrapFile(stdout)
+                          : openFile(positional[1].data(), "wb");
     if (!outputFile) {
-        fmt::print(stderr, "failed to open '{}' file to write\n", argv[2]);
+        fmt::print(stderr, "failed to open '{}' file to write\n",
+                   positional[1]);
         return EXIT_FAILURE;
     }
 
     timer.report("open files");
 
-    std::size_t readSize =
-        readInput(std::begin(input), std::size(input), inputFile);
-    if (readSize == 0) {
-        return EXIT_SUCCESS;
+    bool stream = (positional[0] == "-"sv);  // stdin is counted while read
+    if (!stream) {
+        std::ptrdiff_t readSize = readInput(
+            std::begin(input), std::size(input), makeFileSource(inputFile));
+        if (readSize < 0) {
+            return EXIT_FAILURE;
+        }
+        // empty input is counted too, so that --partial writes an empty
+        // result rather than an empty file and --snapshot outputs the
+        // accumulated counts
+        inputEnd += readSize;
+        timer.report("read input");
+
+        toLower(input, inputEnd);
+        timer.report("make input lowercase");
     }
-    inputEnd += readSize;
-    timer.report("read input");
-
-    toLower(input, inputEnd);
-    timer.report("make input lowercase");
 
     std::vector<TrieNode> trie(1);
-    {
-        uint32_t index = 0;
-        for (auto i = input; i != inputEnd; ++i) {
-            if (*i != '\0') {
-                uint32_t & child = trie[index].children[*i - 'a'];
-                if (child == 0) {
-                    child = uint32_t(trie.size());
-                    index = child;
-                    trie.emplace_back();
-                } else {
-                    index = child;
-                }
-            } else if (index != 0) {
-                ++trie[index].count;
-                index = 0;
-            }
+    auto snapshotHeader = makeSnapshotHeader("trie", "alpha", 0, 0, 0,
+                                             sizeof(TrieNode));
+    if (!snapshotPath.empty()) {
+        if (!readSnapshot(snapshotPath, snapshotHeader, snapshotHeader,
+                          trie))
+        {
+            return EXIT_FAILURE;
         }
+        timer.report("read snapshot");
     }
+
+    uint32_t index = 0;
+    if (stream) {
+        AsyncReader reader{inputFile};
+        while (reader.next()) {
+            toLower(reader.begin(), reader.end());
+            trie::countWords(trie, index, reader.begin(), reader.end());
+        }
+        if (reader.isFailed()) {
+            return EXIT_FAILURE;
+        }
+        fmt::print(stderr, "input size = {} bytes\n", reader.getReadSize());
+    } else {
+        trie::countWords(trie, index, input, inputEnd);
+    }
+    trie::finish(trie, index);
     fmt::print(stderr, "trie size = {}\n", trie.size());
 
     timer.report(fmt::format(fg(fmt::color::dark_blue), "count words"));
 
+    if (!snapshotPath.empty()) {
+        if (!writeSnapshot(snapshotPath, snapshotHeader, trie)) {
+            return EXIT_FAILURE;
+        }
+        timer.report("write snapshot");
+    }
+
     std::vector<std::pair<uint32_t, uint32_t>> rank;
     std::vector<char> words;
-
-    std::vector<char> word;
-    auto traverseTrie = [&](const auto & traverseTrie,
-                            const auto & children) -> void {
-        size_t c = 0;
-        for (uint32_t child : children) {
-            if (child != 0) {
-                const TrieNode & node = trie[child];
-                word.push_back('a' + c);
-                if (node.count != 0) {
-                    rank.emplace_back(node.count, uint32_t(words.size()));
-                    words.insert(std::cend(words), std::cbegin(word),
-                                 std::cend(word));
-                    words.push_back('\0');
-                }
-                traverseTrie(traverseTrie, node.children);
-                word.pop_back();
-            }
-            ++c;
-        }
-    };
-    traverseTrie(traverseTrie, trie.front().children);
-    assert(word.empty());
+    trie::recoverWords(trie, rank, words);
     fmt::print(stderr, "word count = {}, length = {}\n", rank.size(),
                words.size());
 
     timer.report("recover words from trie");
 
-    std::stable_sort(std::begin(rank), std::end(rank),
-                     [](auto && l, auto && r) { return r.first < l.first; });
+    // traversal yields words in ascending order already
+    if (partial) {
+        PartialWriter<> partialWriter{outputFile, "alpha"};
+        for (const auto & [count, word] : rank) {
+            if (!partialWriter.write(std::next(words.data(), word), count)) {
+                fmt::print(stderr, "output failure\n");
+                return EXIT_FAILURE;
+            }
+        }
+        if (!partialWriter.finish()) {
+            fmt::print(stderr, "output failure\n");
+            return EXIT_FAILURE;
+        }
+        timer.report("write output");
+        return EXIT_SUCCESS;
+    }
+
+    std::stable_sort(std::begin(rank), std::end(rank), RankCountLess{});
 
     timer.report(fmt::format(fg(fmt::color::dark_orange), "sort words"));
 
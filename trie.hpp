@@ -0,0 +1,85 @@
+#pragma once
+
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include <cassert>
+#include <cstdint>
+
+// Trie of lowercase words: a node per prefix, words are counted in nodes of
+// their last letters
+namespace trie
+{
+
+constexpr std::size_t kAlphabetSize = 'z' - 'a' + 1;
+
+struct TrieNode
+{
+    uint32_t count = 0;
+    uint32_t children[kAlphabetSize] = {};
+};
+
+// trie.front() is the root, input should be made lowercase by toLower(); index
+// of the node of a word which is not finished at end is carried over to the
+// next block (initially 0)
+inline void countWords(std::vector<TrieNode> & trie, uint32_t & index,
+                       const char * beg, const char * end)
+{
+    for (auto i = beg; i != end; ++i) {
+        if (*i != '\0') {
+            uint32_t & child = trie[index].children[*i - 'a'];
+            if (child == 0) {
+                child = uint32_t(trie.size());
+                index = child;
+                trie.emplace_back();
+            } else {
+                index = child;
+            }
+        } else if (index != 0) {
+            ++trie[index].count;
+            index = 0;
+        }
+    }
+}
+
+// finishes the last word left by countWords()
+inline void finish(std::vector<TrieNode> & trie, uint32_t & index)
+{
+    if (index != 0) {
+        ++trie[index].count;
+        index = 0;
+    }
+}
+
+// (count, offset of word in words) of counted words in ascending order of
+// words, which are NUL-terminated
+inline void recoverWords(const std::vector<TrieNode> & trie,
+                         std::vector<std::pair<uint32_t, uint32_t>> & rank,
+                         std::vector<char> & words)
+{
+    std::vector<char> word;
+    auto traverseTrie = [&](const auto & traverseTrie,
+                            const auto & children) -> void {
+        size_t c = 0;
+        for (uint32_t child : children) {
+            if (child != 0) {
+                const TrieNode & node = trie[child];
+                word.push_back('a' + c);
+                if (node.count != 0) {
+                    rank.emplace_back(node.count, uint32_t(words.size()));
+                    words.insert(std::cend(words), std::cbegin(word),
+                                 std::cend(word));
+                    words.push_back('\0');
+                }
+                traverseTrie(traverseTrie, node.children);
+                word.pop_back();
+            }
+            ++c;
+        }
+    };
+    traverseTrie(traverseTrie, trie.front().children);
+    assert(word.empty());
+}
+
+}  // namespace trie
@@ -0,0 +1,498 @@
+#pragma once
+
+#include "helpers.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+#include <cstdint>
+#include <cstring>
+
+namespace utf8
+{
+
+// [p, end) can be shorter than a block, then it is padded with NULs
+inline __m128i loadBlock(const char * p, const char * end)
+{
+    if (std::distance(p, end) >= std::ptrdiff_t(sizeof(__m128i))) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    }
+    alignas(__m128i) char tail[sizeof(__m128i)] = {};
+    std::copy(p, end, tail);
+    return _mm_load_si128(reinterpret_cast<const __m128i *>(tail));
+}
+
+// UTF-8 validation: lookup algorithm of J. Keiser and D. Lemire, "Validating
+// UTF-8 In Less Than One Instruction Per Byte"
+class Validator
+{
+public:
+    void update(__m128i input)
+    {
+        if (_mm_movemask_epi8(input) == 0) {
+            error = _mm_or_si128(error, incomplete);
+        } else {
+            __m128i prev1 = _mm_alignr_epi8(input, previous, 16 - 1);
+            __m128i specialCases = checkSpecialCases(input, prev1);
+            error = _mm_or_si128(
+                error, checkMultibyteLengths(input, previous, specialCases));
+            incomplete = isIncomplete(input);
+        }
+        previous = input;
+    }
+
+    // [beg, end) can be of any length and alignment
+    void update(const char * beg, const char * end)
+    {
+        for (; std::distance(beg, end) >= std::ptrdiff_t(sizeof(__m128i));
+             beg += sizeof(__m128i))
+        {
+            update(_mm_loadu_si128(reinterpret_cast<const __m128i *>(beg)));
+        }
+        if (beg != end) {
+            update(loadBlock(beg, end));
+        }
+    }
+
+    bool isValid() const
+    {
+        __m128i e = _mm_or_si128(error, incomplete);
+        return _mm_testz_si128(e, e) != 0;
+    }
+
+private:
+    static constexpr uint8_t kTooShort = 1 << 0;
+    static constexpr uint8_t kTooLong = 1 << 1;
+    static constexpr uint8_t kOverlong3 = 1 << 2;
+    static constexpr uint8_t kTooLarge = 1 << 3;
+    static constexpr uint8_t kSurrogate = 1 << 4;
+    static constexpr uint8_t kOverlong2 = 1 << 5;
+    static constexpr uint8_t kTooLarge1000 = 1 << 6;
+    static constexpr uint8_t kOverlong4 = 1 << 6;
+    static constexpr uint8_t kTwoConts = 1 << 7;
+    static constexpr uint8_t kCarry = kTooShort | kTooLong | kTwoConts;
+
+    __m128i error = _mm_setzero_si128();
+    __m128i previous = _mm_setzero_si128();
+    __m128i incomplete = _mm_setzero_si128();
+
+    static __m128i highNibble(__m128i v)
+    {
+        return _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0F));
+    }
+
+    static __m128i lowNibble(__m128i v)
+    {
+        return _mm_and_si128(v, _mm_set1_epi8(0x0F));
+    }
+
+    static __m128i checkSpecialCases(__m128i input, __m128i prev1)
+    {
+        const __m128i byte1HighTable = _mm_setr_epi8(
+            kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong,
+            kTooLong, kTooLong, kTwoConts, kTwoConts, kTwoConts, kTwoConts,
+            kTooShort | kOverlong2, kTooShort,
+            kTooShort | kOverlong3 | kSurrogate,
+            kTooShort | kTooLarge | kTooLarge1000 | kOverlong4);
+        const __m128i byte1LowTable = _mm_setr_epi8(
+            kCarry | kOverlong3 | kOverlong2 | kOverlong4, kCarry | kOverlong2,
+            kCarry, kCarry, kCarry | kTooLarge,
+            kCarry | kTooLarge | kTooLarge1000,
+            kCarry | kTooLarge | kTooLarge1000,
+            kCarry | kTooLarge | kTooLarge1000,
+            kCarry | kTooLarge | kTooLarge1000,
+            kCarry | kTooLarge | kTooLarge1000,
+            kCarry | kTooLarge | kTooLarge1000,
+            kCarry | kTooLarge | kTooLarge1000,
+            kCarry | kTooLarge | kTooLarge1000,
+            kCarry | kTooLarge | kTooLarge1000 | kSurrogate,
+            kCarry | kTooLarge | kTooLarge1000,
+            kCarry | kTooLarge | kTooLarge1000);
+        const __m128i byte2HighTable = _mm_setr_epi8(
+            kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort,
+            kTooShort, kTooShort,
+            char(kTooLong | kOverlong2 | kTwoConts | kOverlong3 |
+                 kTooLarge1000 | kOverlong4),
+            char(kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge),
+            char(kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge),
+            char(kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge),
+            kTooShort, kTooShort, kTooShort, kTooShort);
+        __m128i byte1High = _mm_shuffle_epi8(byte1HighTable, highNibble(prev1));
+        __m128i byte1Low = _mm_shuffle_epi8(byte1LowTable, lowNibble(prev1));
+        __m128i byte2High = _mm_shuffle_epi8(byte2HighTable, highNibble(input));
+        return _mm_and_si128(_mm_and_si128(byte1High, byte1Low), byte2High);
+    }
+
+    static __m128i checkMultibyteLengths(__m128i input, __m128i previous,
+                                         __m128i specialCases)
+    {
+        __m128i prev2 = _mm_alignr_epi8(input, previous, 16 - 2);
+        __m128i prev3 = _mm_alignr_epi8(input, previous, 16 - 3);
+        // only 111_____ and 1111____ respectively are >= 0x80 after that
+        __m128i isThirdByte = _mm_subs_epu8(prev2, _mm_set1_epi8(0xE0 - 0x80));
+        __m128i isFourthByte = _mm_subs_epu8(prev3, _mm_set1_epi8(0xF0 - 0x80));
+        __m128i must23 = _mm_and_si128(_mm_or_si128(isThirdByte, isFourthByte),
+                                       _mm_set1_epi8(char(0x80)));
+        return _mm_xor_si128(must23, specialCases);
+    }
+
+    // non-zero if the last bytes start a sequence which is not finished yet
+    static __m128i isIncomplete(__m128i input)
+    {
+        const __m128i maxValue =
+            _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                          char(0xF0 - 1), char(0xE0 - 1), char(0xC0 - 1));
+        return _mm_subs_epu8(input, maxValue);
+    }
+};
+
+// sorted ranges of code points treated as letters (including combining marks,
+// so that words in decomposed form are not split)
+inline constexpr uint32_t kLetters[][2] = {
+    {0x00AA, 0x00AA},   {0x00B5, 0x00B5},   {0x00BA, 0x00BA},
+    {0x00C0, 0x00D6},   {0x00D8, 0x00F6},   {0x00F8, 0x02C1},
+    {0x02C6, 0x02D1},   {0x02E0, 0x02E4},   {0x02EC, 0x02EC},
+    {0x02EE, 0x02EE},   {0x0300, 0x0374},   {0x0376, 0x0377},
+    {0x037A, 0x037D},   {0x037F, 0x037F},   {0x0386, 0x0386},
+    {0x0388, 0x038A},   {0x038C, 0x038C},   {0x038E, 0x03A1},
+    {0x03A3, 0x03F5},   {0x03F7, 0x0481},   {0x0483, 0x052F},
+    {0x0531, 0x0556},   {0x0559, 0x0559},   {0x0560, 0x0588},
+    {0x0591, 0x05BD},   {0x05BF, 0x05BF},   {0x05C1, 0x05C2},
+    {0x05C4, 0x05C5},   {0x05C7, 0x05C7},   {0x05D0, 0x05EA},
+    {0x05EF, 0x05F2},   {0x0610, 0x061A},   {0x0620, 0x065F},
+    {0x066E, 0x06D3},   {0x06D5, 0x06DC},   {0x06DF, 0x06E8},
+    {0x06EA, 0x06EF},   {0x06FA, 0x06FC},   {0x06FF, 0x06FF},
+    {0x0900, 0x0963},   {0x0971, 0x097F},   {0x0E01, 0x0E3A},
+    {0x0E40, 0x0E4E},   {0x10A0, 0x10C5},   {0x10C7, 0x10C7},
+    {0x10CD, 0x10CD},   {0x10D0, 0x10FA},   {0x10FC, 0x10FF},
+    {0x1100, 0x11FF},   {0x1E00, 0x1F15},   {0x1F18, 0x1F1D},
+    {0x1F20, 0x1F45},   {0x1F48, 0x1F4D},   {0x1F50, 0x1F57},
+    {0x1F59, 0x1F59},   {0x1F5B, 0x1F5B},   {0x1F5D, 0x1F5D},
+    {0x1F5F, 0x1F7D},   {0x1F80, 0x1FB4},   {0x1FB6, 0x1FBC},
+    {0x1FC2, 0x1FC4},   {0x1FC6, 0x1FCC},   {0x1FD0, 0x1FD3},
+    {0x1FD6, 0x1FDB},   {0x1FE0, 0x1FEC},   {0x1FF2, 0x1FF4},
+    {0x1FF6, 0x1FFC},   {0x3041, 0x3096},   {0x3099, 0x309F},
+    {0x30A1, 0x30FA},   {0x30FC, 0x30FF},   {0x3400, 0x4DBF},
+    {0x4E00, 0x9FFF},   {0xAC00, 0xD7A3},   {0xF900, 0xFAFF},
+    {0xFF21, 0xFF3A},   {0xFF41, 0xFF5A},   {0xFF66, 0xFF9F},
+    {0x20000, 0x2FA1F},
+};
+
+inline bool isLetter(uint32_t c)
+{
+    auto it = std::upper_bound(
+        std::cbegin(kLetters), std::cend(kLetters), c,
+        [](uint32_t c, const uint32_t(&range)[2]) { return c < range[0]; });
+    return (it != std::cbegin(kLetters)) && (c <= std::prev(it)[0][1]);
+}
+
+// simple case folding of Latin, Greek, Cyrillic, Armenian and fullwidth Latin
+// letters
+inline uint32_t foldCase(uint32_t c)
+{
+    auto isEven = [](uint32_t c) { return (c % 2) == 0; };
+    if (c < 0x00C0) {
+        return ((c >= 'A') && (c <= 'Z')) ? (c + ('a' - 'A')) : c;
+    } else if (c < 0x0100) {
+        return ((c <= 0x00DE) && (c != 0x00D7)) ? (c + 0x20) : c;
+    } else if (c < 0x0180) {
+        if (c == 0x0178) {
+            return 0x00FF;
+        } else if (c == 0x017F) {
+            return 's';
+        } else if ((c >= 0x0139 && c <= 0x0148) ||
+                   (c >= 0x0179 && c <= 0x017E))
+        {
+            return isEven(c) ? c : (c + 1);
+        } else if (c == 0x0130 || c == 0x0131 || c == 0x0138 || c == 0x0149) {
+            return c;
+        }
+        return isEven(c) ? (c + 1) : c;
+    } else if (c >= 0x0370 && c < 0x0400) {
+        if ((c >= 0x0391 && c <= 0x03A1) || (c >= 0x03A3 && c <= 0x03AB)) {
+            return c + 0x20;
+        } else if (c == 0x0386) {
+            return 0x03AC;
+        } else if (c >= 0x0388 && c <= 0x038A) {
+            return c + 0x25;
+        } else if (c == 0x038C) {
+            return 0x03CC;
+        } else if (c == 0x038E || c == 0x038F) {
+            return c + 0x3F;
+        } else if (c == 0x03C2) {
+            return 0x03C3;
+        }
+        return c;
+    } else if (c >= 0x0400 && c < 0x0530) {
+        if (c < 0x0410) {
+            return c + 0x50;
+        } else if (c < 0x0430) {
+            return c + 0x20;
+        } else if ((c >= 0x0460 && c <= 0x0481) ||
+                   (c >= 0x048A && c <= 0x04BF) || (c >= 0x04D0))
+        {
+            return isEven(c) ? (c + 1) : c;
+        } else if (c == 0x04C0) {
+            return 0x04CF;
+        } else if (c >= 0x04C1 && c <= 0x04CE) {
+            return isEven(c) ? c : (c + 1);
+        }
+        return c;
+    } else if (c >= 0x0531 && c <= 0x0556) {
+        return c + 0x30;
+    } else if ((c >= 0x1E00 && c <= 0x1E95) || (c >= 0x1EA0 && c <= 0x1EFF)) {
+        return isEven(c) ? (c + 1) : c;
+    } else if (c >= 0xFF21 && c <= 0xFF3A) {
+        return c + 0x20;
+    }
+    return c;
+}
+
+inline uint32_t encodedLength(uint32_t c)
+{
+    return (c < 0x80) ? 1 : (c < 0x800) ? 2 : (c < 0x10000) ? 3 : 4;
+}
+
+// returns length of a valid sequence at [i, end) or 0
+inline uint32_t decode(const char * i, const char * end, uint32_t & c)
+{
+    auto byte = [i](std::ptrdiff_t n) { return uint8_t(i[n]); };
+    auto isContinuation = [&](std::ptrdiff_t n) {
+        return (byte(n) & 0xC0) == 0x80;
+    };
+    auto available = std::distance(i, end);
+    uint8_t lead = byte(0);
+    if (lead < 0xC2 || lead > 0xF4) {
+        return 0;
+    } else if (lead < 0xE0) {
+        if (available < 2 || !isContinuation(1)) {
+            return 0;
+        }
+        c = (uint32_t(lead & 0x1F) << 6) | (byte(1) & 0x3F);
+        return 2;
+    } else if (lead < 0xF0) {
+        if (available < 3 || !isContinuation(1) || !isContinuation(2)) {
+            return 0;
+        }
+        c = (uint32_t(lead & 0x0F) << 12) | (uint32_t(byte(1) & 0x3F) << 6) |
+            (byte(2) & 0x3F);
+        return (c < 0x800 || (c >= 0xD800 && c <= 0xDFFF)) ? 0 : 3;
+    }
+    if (available < 4 || !isContinuation(1) || !isContinuation(2) ||
+        !isContinuation(3))
+    {
+        return 0;
+    }
+    c = (uint32_t(lead & 0x07) << 18) | (uint32_t(byte(1) & 0x3F) << 12) |
+        (uint32_t(byte(2) & 0x3F) << 6) | (byte(3) & 0x3F);
+    return (c < 0x10000 || c > 0x10FFFF) ? 0 : 4;
+}
+
+inline void encode(uint32_t c, char * o)
+{
+    switch (encodedLength(c)) {
+    case 1:
+        o[0] = char(c);
+        break;
+    case 2:
+        o[0] = char(0xC0 | (c >> 6));
+        o[1] = char(0x80 | (c & 0x3F));
+        break;
+    case 3:
+        o[0] = char(0xE0 | (c >> 12));
+        o[1] = char(0x80 | ((c >> 6) & 0x3F));
+        o[2] = char(0x80 | (c & 0x3F));
+        break;
+    default:
+        o[0] = char(0xF0 | (c >> 18));
+        o[1] = char(0x80 | ((c >> 12) & 0x3F));
+        o[2] = char(0x80 | ((c >> 6) & 0x3F));
+        o[3] = char(0x80 | (c & 0x3F));
+    }
+}
+
+inline __m128i toLowerAscii(__m128i string)
+{
+    __m128i lowercase = _mm_add_epi8(
+        string, _mm_and_si128(_mm_cmplt_epi8(string, _mm_set1_epi8('a')),
+                              _mm_set1_epi8('a' - 'A')));
+    __m128i mask = _mm_or_si128(_mm_cmplt_epi8(lowercase, _mm_set1_epi8('a')),
+                                _mm_cmpgt_epi8(lowercase, _mm_set1_epi8('z')));
+    return _mm_andnot_si128(mask, lowercase);
+}
+
+// v in [lo, hi] as unsigned bytes
+inline __m128i isInRange(__m128i v, uint8_t lo, uint8_t hi)
+{
+    __m128i offset = _mm_sub_epi8(v, _mm_set1_epi8(char(lo)));
+    return _mm_cmpeq_epi8(
+        _mm_min_epu8(offset, _mm_set1_epi8(char(hi - lo))), offset);
+}
+
+inline __m128i isEqualTo(__m128i v, uint8_t c)
+{
+    return _mm_cmpeq_epi8(v, _mm_set1_epi8(char(c)));
+}
+
+// Folds 16 bytes at p in place like foldUtf8() does code point by code point,
+// if they are ASCII and 2-byte sequences of Latin-1 (leads C2 and C3), Greek
+// (CE and CF) and Cyrillic (D0 and D1): a letter is told by its lead and
+// continuation byte, and case folding is an addition to the continuation
+// byte, which carries into the lead byte for Greek and Cyrillic capitals.
+// Returns the number of bytes done: 16, 15 if the last byte is a lead byte
+// (left as is), 0 if the bytes are not covered, U+0380..U+0390 (capitals with
+// tonos among them) included.
+inline uint32_t foldBlock(char * p)
+{
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    if (_mm_movemask_epi8(v) == 0) {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(p), toLowerAscii(v));
+        return sizeof(__m128i);
+    }
+    __m128i isAscii = _mm_cmpgt_epi8(v, _mm_set1_epi8(-1));
+    __m128i isContinuation =
+        isEqualTo(_mm_and_si128(v, _mm_set1_epi8(char(0xC0))), 0x80);
+    __m128i isLead = _mm_cmpeq_epi8(_mm_or_si128(isAscii, isContinuation),
+                                    _mm_setzero_si128());
+    auto leadMask = uint32_t(_mm_movemask_epi8(isLead));
+    auto continuationMask = uint32_t(_mm_movemask_epi8(isContinuation));
+    if (continuationMask != ((leadMask << 1) & 0xFFFF)) {
+        return 0;  // not only 2-byte sequences, or invalid ones
+    }
+    // leads of continuation bytes
+    __m128i lead = _mm_slli_si128(v, 1);
+    auto isOfLead = [&](uint8_t c) {
+        return _mm_and_si128(isContinuation, isEqualTo(lead, c));
+    };
+    __m128i isC2 = isOfLead(0xC2);
+    __m128i isC3 = isOfLead(0xC3);
+    __m128i isCE = isOfLead(0xCE);
+    __m128i isCF = isOfLead(0xCF);
+    __m128i isD0 = isOfLead(0xD0);
+    __m128i isD1 = isOfLead(0xD1);
+    __m128i isCovered = _mm_or_si128(
+        _mm_or_si128(_mm_or_si128(isC2, isC3), _mm_or_si128(isCE, isCF)),
+        _mm_or_si128(isD0, isD1));
+    __m128i isUncoveredGreek = _mm_and_si128(isCE, isInRange(v, 0x80, 0x90));
+    if ((uint32_t(_mm_movemask_epi8(isCovered)) != continuationMask) ||
+        (_mm_movemask_epi8(isUncoveredGreek) != 0))
+    {
+        return 0;
+    }
+
+    // U+00AA, U+00B5 and U+00BA are the only letters of C2
+    __m128i isNotLetter = _mm_andnot_si128(
+        _mm_or_si128(_mm_or_si128(isEqualTo(v, 0xAA), isEqualTo(v, 0xB5)),
+                     isEqualTo(v, 0xBA)),
+        isC2);
+    // U+00D7, U+00F7, U+03A2 and U+03F6
+    isNotLetter = _mm_or_si128(
+        isNotLetter,
+        _mm_or_si128(
+            _mm_and_si128(isC3, _mm_or_si128(isEqualTo(v, 0x97),
+                                             isEqualTo(v, 0xB7))),
+            _mm_or_si128(_mm_and_si128(isCE, isEqualTo(v, 0xA2)),
+                         _mm_and_si128(isCF, isEqualTo(v, 0xB6)))));
+
+    // U+00C0..U+00DE, U+0391..U+039F and U+0410..U+041F
+    __m128i add20 = _mm_or_si128(
+        _mm_andnot_si128(isEqualTo(v, 0x97),
+                         _mm_and_si128(isC3, isInRange(v, 0x80, 0x9E))),
+        _mm_and_si128(_mm_or_si128(isCE, isD0), isInRange(v, 0x90, 0x9F)));
+    // U+03A0..U+03AB to U+03C0..U+03CB, U+0420..U+042F to U+0440..U+044F
+    __m128i sub20 = _mm_or_si128(
+        _mm_andnot_si128(isEqualTo(v, 0xA2),
+                         _mm_and_si128(isCE, isInRange(v, 0xA0, 0xAB))),
+        _mm_and_si128(isD0, isInRange(v, 0xA0, 0xAF)));
+    // U+0400..U+040F to U+0450..U+045F
+    __m128i add10 = _mm_and_si128(isD0, isInRange(v, 0x80, 0x8F));
+    // U+03C2 and even ones of U+0460..U+047F
+    __m128i isEven = isEqualTo(_mm_and_si128(v, _mm_set1_epi8(1)), 0);
+    __m128i add1 = _mm_or_si128(
+        _mm_and_si128(isCF, isEqualTo(v, 0x82)),
+        _mm_and_si128(isD1, _mm_and_si128(isEven, isInRange(v, 0xA0, 0xBF))));
+    __m128i delta = _mm_or_si128(
+        _mm_or_si128(_mm_and_si128(add20, _mm_set1_epi8(0x20)),
+                     _mm_and_si128(sub20, _mm_set1_epi8(-0x20))),
+        _mm_or_si128(_mm_and_si128(add10, _mm_set1_epi8(0x10)),
+                     _mm_and_si128(add1, _mm_set1_epi8(1))));
+    // the carry into the lead byte
+    __m128i leadDelta = _mm_and_si128(
+        _mm_srli_si128(_mm_or_si128(sub20, add10), 1), _mm_set1_epi8(1));
+    __m128i folded = _mm_add_epi8(v, _mm_add_epi8(delta, leadDelta));
+    folded = _mm_andnot_si128(
+        _mm_or_si128(isNotLetter, _mm_srli_si128(isNotLetter, 1)), folded);
+    folded = _mm_blendv_epi8(folded, toLowerAscii(v), isAscii);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p), folded);
+    return ((leadMask & 0x8000) != 0) ? 15 : 16;
+}
+
+}  // namespace utf8
+
+// UTF-8 counterpart of toLower(): folds case of letters and replaces all other
+// code points (and invalid sequences) by NULs in place, so words become runs
+// of non-NUL bytes. Blocks of ASCII, Latin-1, Greek and Cyrillic take SIMD
+// paths, folding is applied only if it keeps the length of an encoded code
+// point. [beg, end) can be of any length and alignment. Returns false if input
+// is not valid UTF-8.
+inline bool foldUtf8(char * beg, char * const end)
+{
+    assert(beg <= end);
+    // a sequence can cross the end of a block, so the next block is validated
+    // before the current one is modified
+    utf8::Validator validator;
+    char * i = beg;
+    char * blockBegin = beg;
+    __m128i block = utf8::loadBlock(blockBegin, end);
+    validator.update(block);
+    while (blockBegin < end) {
+        char * blockEnd =
+            std::next(blockBegin, std::min(std::distance(blockBegin, end),
+                                           std::ptrdiff_t(sizeof(__m128i))));
+        __m128i nextBlock = _mm_setzero_si128();
+        if (blockEnd < end) {
+            nextBlock = utf8::loadBlock(blockEnd, end);
+            validator.update(nextBlock);
+        }
+        if (_mm_movemask_epi8(block) == 0 && blockEnd == (i + sizeof(__m128i)))
+        {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(i),
+                             utf8::toLowerAscii(block));
+            i = blockEnd;
+        }
+        while (i < blockEnd) {
+            // bytes up to the end of the next block are validated already
+            if (std::distance(i, end) >= std::ptrdiff_t(sizeof(__m128i))) {
+                if (uint32_t length = utf8::foldBlock(i)) {
+                    i += length;
+                    continue;
+                }
+            }
+            auto c = uint8_t(*i);
+            if (c < 0x80) {
+                c |= 0x20;
+                *i++ = ((c >= 'a') && (c <= 'z')) ? char(c) : '\0';
+                continue;
+            }
+            uint32_t codePoint = 0;
+            uint32_t length = utf8::decode(i, end, codePoint);
+            if (length == 0) {
+                *i++ = '\0';
+            } else if (!utf8::isLetter(codePoint)) {
+                std::memset(i, '\0', length);
+                i += length;
+            } else {
+                uint32_t folded = utf8::foldCase(codePoint);
+                if (folded != codePoint &&
+                    utf8::encodedLength(folded) == length)
+                {
+                    utf8::encode(folded, i);
+                }
+                i += length;
+            }
+        }
+        blockBegin = blockEnd;
+        block = nextBlock;
+    }
+    return validator.isValid();
+}
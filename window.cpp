@@ -0,0 +1,208 @@
+#include "charclass.hpp"
+#include "helpers.hpp"
+#include "io.hpp"
+#include "options.hpp"
+#include "timer.hpp"
+#include "window.hpp"
+
+#include <fmt/color.h>
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <string_view>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include <poll.h>
+#include <unistd.h>
+
+// Streaming top words of a sliding window: every --every bytes of input or
+// --every-seconds (whichever comes first) the current block of input ends and
+// the top words of the last --window blocks are written, followed by an empty
+// line. Input is read as it arrives, so that tailed logs are counted live.
+int main(int argc, char * argv[])
+{
+    Timer timer{fmt::format(fg(fmt::color::dark_green), "total")};
+
+    Options options{argc, argv};
+    const auto & positional = options.getPositional();
+    if (positional.size() != 2) {
+        fmt::print(stderr,
+                   "usage: {} [--every=1048576] [--every-seconds=0] "
+                   "[--window=10] [--top=10] in.txt|- out.txt|-\n",
+                   argv[0]);
+        return EXIT_FAILURE;
+    }
+    std::size_t every = 1 << 20;
+    double everySeconds = 0.0;
+    std::size_t blockCount = 10;
+    std::size_t top = 10;
+    if (!options.get("every", every) ||
+        !options.get("every-seconds", everySeconds) ||
+        !options.get("window", blockCount) || !options.get("top", top))
+    {
+        return EXIT_FAILURE;
+    }
+    if ((every == 0) || (blockCount == 0) || (everySeconds < 0.0)) {
+        fmt::print(stderr,
+                   "--every and --window should be positive, --every-seconds "
+                   "should not be negative\n");
+        return EXIT_FAILURE;
+    }
+
+    using namespace std::string_view_literals;
+
+    auto inputFile = (positional[0] == "-"sv)
+                         ? wrapFile(stdin)
+                         : openFile(positional[0].data(), "rb");
+    if (!inputFile) {
+        fmt::print(stderr, "failed to open '{}' file to read\n",
+                   positional[0]);
+        return EXIT_FAILURE;
+    }
+
+    auto outputFile = (positional[1] == "-"sv)
+                          ? wrapFile(stdout)
+                          : openFile(positional[1].data(), "wb");
+    if (!outputFile) {
+        fmt::print(stderr, "failed to open '{}' file to write\n",
+                   positional[1]);
+        return EXIT_FAILURE;
+    }
+    OutputStream<> outputStream{outputFile};
+
+    using Clock = std::chrono::steady_clock;
+    auto period = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(everySeconds));
+    auto deadline = Clock::now() + period;
+
+    SlidingWindow slidingWindow{blockCount, top};
+    std::size_t blockSerial = 0;
+    std::size_t blockSize = 0;
+    auto emit = [&] {
+        if (!slidingWindow.nextBlock()) {
+            fmt::print(stderr, "too many distinct words in the window\n");
+            return false;
+        }
+        bool success = true;
+        slidingWindow.forEachTopWord([&](uint64_t count,
+                                         std::string_view word) {
+            success = success && outputStream.print(count) &&
+                      outputStream.putChar(' ') && outputStream.print(word) &&
+                      outputStream.putChar('\n');
+        });
+        if (!success || !outputStream.putChar('\n') || !outputStream.flush()) {
+            fmt::print(stderr, "output failure\n");
+            return false;
+        }
+        ++blockSerial;
+        blockSize = 0;
+        deadline = Clock::now() + period;
+        return true;
+    };
+
+    // input is counted by multiples of sizeof(__m128i), the rest is moved to
+    // the front of the buffer with the bytes of the unfinished word before it.
+    // It is the carry of AsyncReader and of libfreq's Context, but input can
+    // not be read by AsyncReader: next() waits for whole blocks, while input
+    // here is polled with a timeout for --every-seconds, counted as soon as it
+    // arrives and split into blocks at --every bytes
+    constexpr std::size_t kBufferSize = 1 << 20;
+    constexpr std::size_t kMaxCarry = 1 << 16;
+    AlignedBuffer storage =
+        makeAlignedBuffer(kMaxCarry + kBufferSize + sizeof(__m128i));
+    char * buffer = std::next(storage.get(), kMaxCarry);
+    std::size_t size = 0;  // bytes in buffer
+    uint32_t hash = oaph::kInitialChecksum;
+    uint32_t len = 0;
+    auto countBuffer = [&] {
+        std::size_t counted = 0;
+        for (;;) {
+            auto countSize =
+                (size - counted) / sizeof(__m128i) * sizeof(__m128i);
+            if (countSize == 0) {
+                break;
+            }
+            // blocks end at --every bytes, rounded up to sizeof(__m128i)
+            auto blockRest = (every - blockSize + sizeof(__m128i) - 1) /
+                             sizeof(__m128i) * sizeof(__m128i);
+            countSize = std::min(countSize, blockRest);
+            char * beg = std::next(buffer, std::ptrdiff_t(counted));
+            char * end = std::next(beg, std::ptrdiff_t(countSize));
+            toLower<charclass::Alpha>(beg, end);
+            slidingWindow.countWords(beg, end, hash, len);
+            counted += countSize;
+            blockSize += countSize;
+            if ((blockSize >= every) && !emit()) {
+                return false;
+            }
+        }
+        if (len > kMaxCarry) {
+            fmt::print(stderr, "word is longer than {} bytes\n", kMaxCarry);
+            return false;
+        }
+        auto end = std::next(buffer, std::ptrdiff_t(counted));
+        std::copy(std::prev(end, std::ptrdiff_t(len)),
+                  std::next(buffer, std::ptrdiff_t(size)),
+                  std::prev(buffer, std::ptrdiff_t(len)));
+        size -= counted;
+        return true;
+    };
+
+    int fd = fileno(inputFile.get());
+    for (;;) {
+        int timeout = -1;
+        if (everySeconds > 0.0) {
+            auto remaining = std::chrono::ceil<std::chrono::milliseconds>(
+                deadline - Clock::now());
+            timeout = int(std::max<int64_t>(remaining.count(), 0));
+        }
+        pollfd pfd = {fd, POLLIN, 0};
+        int ready = poll(&pfd, 1, timeout);
+        if ((ready < 0) && (errno != EINTR)) {
+            fmt::print(stderr, "failed to poll input\n");
+            return EXIT_FAILURE;
+        }
+        if (ready > 0) {
+            auto readSize = read(fd, std::next(buffer, std::ptrdiff_t(size)),
+                                 kBufferSize - size);
+            if ((readSize < 0) && (errno != EINTR)) {
+                fmt::print(stderr, "failed to read input\n");
+                return EXIT_FAILURE;
+            }
+            if (readSize == 0) {
+                break;
+            }
+            size += std::size_t(std::max<decltype(readSize)>(readSize, 0));
+            if (!countBuffer()) {
+                return EXIT_FAILURE;
+            }
+        }
+        if ((everySeconds > 0.0) && (Clock::now() >= deadline) && !emit()) {
+            return EXIT_FAILURE;
+        }
+    }
+    // NUL padding ends the last word
+    auto paddedSize = (size + sizeof(__m128i)) / sizeof(__m128i) *
+                      sizeof(__m128i);
+    std::fill(std::next(buffer, std::ptrdiff_t(size)),
+              std::next(buffer, std::ptrdiff_t(paddedSize)), '\0');
+    size = paddedSize;
+    if (!countBuffer()) {
+        return EXIT_FAILURE;
+    }
+    // the padded input may end right on a block boundary, then the last block
+    // is emitted by countBuffer() already
+    if ((blockSize != 0) && !emit()) {
+        return EXIT_FAILURE;
+    }
+    fmt::print(stderr, "{} blocks\n", blockSerial);
+    timer.report("count words");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,309 @@
+#pragma once
+
+#include "memory.hpp"
+#include "oaph.hpp"
+#include "rank.hpp"
+#include "tokenizer.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <set>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <cstdint>
+
+// Counts of words over the last blocks of a stream: words are counted into a
+// single table as they come, every block keeps the deltas it made (one entry
+// per distinct word), so that a block leaving the window is subtracted from
+// the table by its deltas rather than the window being recounted. Only words
+// of counts not less than a threshold are ranked, by an ordered set updated by
+// the deltas of the entering and leaving blocks, thus the cost of a block does
+// not depend on the window size, and rare words do not touch the set at all.
+class SlidingWindow
+{
+public:
+    // perfect hash seeds do not cover arbitrary input
+    using HashTable = oaph::HashTable</* kEnableOpenAddressing */ true>;
+
+    // half of the slots of the table, words of zero count are dropped by
+    // compact() to stay below
+    static constexpr std::size_t kMaxWordCount =
+        std::extent_v<decltype(HashTable::words)> *
+        std::extent_v<decltype(HashTable::words), 1> / 2;
+
+    SlidingWindow(std::size_t blockCount, std::size_t top)
+        : hashTable{mapZeroed<HashTable>()},
+          blockCount{blockCount},
+          top{top},
+          candidateCount{std::max(kCandidateFactor * top, kMinCandidateCount)}
+    {
+        hashTable->init();
+        blocks.emplace_back();
+    }
+
+    ~SlidingWindow()
+    {
+        hashTable->arena.release();
+    }
+
+    // HashTable::countWords() of input made lowercase by toLower(), into the
+    // current block
+    void countWords(const char * beg, const char * end, uint32_t & hash,
+                    uint32_t & len)
+    {
+        auto onWord = [this](uint32_t hash, const char * wordEnd,
+                             uint32_t len) { addWord(hash, wordEnd, len); };
+        tokenize</* kInputIsLowercase */ true>(beg, end, oaph::kInitialChecksum,
+                                               hash, len, onWord);
+    }
+
+    // ranks words of the current block, the oldest block leaves the window if
+    // it is full, then a new block is started; false if there are too many
+    // distinct words in the window
+    bool nextBlock()
+    {
+        for (const Delta & delta : blocks.back()) {
+            uint64_t count = getWordCount(delta);
+            updateCount(delta.word, count - delta.count, count);
+        }
+        if (blocks.size() > blockCount) {
+            for (const Delta & delta : blocks.front()) {
+                auto word = hashTable->arena.getWord(delta.word);
+                hashTable->incCounter(
+                    delta.hash,
+                    std::next(word.data(), std::ptrdiff_t(word.size())),
+                    uint32_t(word.size()), uint64_t(0) - delta.count);
+                uint64_t count = getWordCount(delta);
+                updateCount(delta.word, count + delta.count, count);
+            }
+            blocks.pop_front();
+        }
+        if ((rank.size() < top) && (threshold > 1)) {
+            rerank();
+        } else if (rank.size() > 4 * candidateCount) {
+            trimRank();
+        }
+        if ((wordCount > 2 * liveWordCount + kMaxWordCount / 4) ||
+            (wordCount > kMaxWordCount))
+        {
+            compact();
+        }
+        blocks.emplace_back();
+        ++blockSerial;
+        return !hashTable->arena.isFull() && (wordCount <= kMaxWordCount);
+    }
+
+    // onWord(count, word) for top words of the window by descending count,
+    // then by ascending word, as of the last nextBlock()
+    template<typename OnWord>
+    void forEachTopWord(OnWord && onWord) const
+    {
+        std::size_t rest = top;
+        for (auto it = std::cbegin(rank);
+             (it != std::cend(rank)) && (rest != 0); ++it, --rest)
+        {
+            onWord(it->count, hashTable->arena.getWord(it->word));
+        }
+    }
+
+private:
+    // words of counts not less than the threshold are ranked, it is chosen to
+    // rank that many words for every top one, at least kMinCandidateCount
+    static constexpr std::size_t kCandidateFactor = 4;
+    static constexpr std::size_t kMinCandidateCount = 256;
+
+    struct Delta
+    {
+        uint32_t word;  // reference in arena
+        uint32_t hash;
+        uint64_t count;
+    };
+
+    struct WordLess
+    {
+        const HashTable * hashTable;
+
+        bool operator()(uint32_t lhs, uint32_t rhs) const
+        {
+            return hashTable->arena.getWord(lhs) <
+                   hashTable->arena.getWord(rhs);
+        }
+    };
+
+    // (block serial, delta) by word reference, for words of the current block
+    struct DeltaIndex
+    {
+        uint32_t blockSerial = 0;
+        uint32_t delta = 0;
+    };
+
+    MappedPtr<HashTable> hashTable;
+    std::size_t blockCount;
+    std::size_t top;
+    std::size_t candidateCount;
+    std::deque<std::vector<Delta>> blocks;  // the last one is being counted
+    uint32_t blockSerial = 1;
+    std::vector<DeltaIndex> deltaIndices;
+    // ties are mostly resolved by inline prefixes, rather than by words
+    std::set<PrefixRankEntry<uint32_t>, PrefixRankLess<WordLess>> rank{
+        PrefixRankLess<WordLess>{{hashTable.get()}}};
+    uint64_t threshold = 1;  // words of lesser counts are not in rank
+    std::size_t wordCount = 0;  // stored in the table, also of zero count
+    std::size_t liveWordCount = 0;  // of nonzero count
+
+    void addWord(uint32_t hash, const char * wordEnd, uint32_t len)
+    {
+        uint64_t top = hashTable->arena.top;
+        uint32_t word = hashTable->incCounter(hash, wordEnd, len);
+        if UNLIKELY (word == 0) {
+            return;  // arena is full, reported by nextBlock()
+        }
+        if (hashTable->arena.top != top) {
+            ++wordCount;
+        }
+        if (word >= deltaIndices.size()) {
+            deltaIndices.resize(std::max<std::size_t>(
+                hashTable->arena.top, 2 * deltaIndices.size()));
+        }
+        DeltaIndex & deltaIndex = deltaIndices[word];
+        auto & block = blocks.back();
+        if (deltaIndex.blockSerial != blockSerial) {
+            deltaIndex = {blockSerial, uint32_t(block.size())};
+            block.push_back({word, hash, 0});
+        }
+        ++block[deltaIndex.delta].count;
+    }
+
+    uint64_t getWordCount(const Delta & delta) const
+    {
+        auto word = hashTable->arena.getWord(delta.word);
+        return hashTable->getWordCount(
+            delta.hash, std::next(word.data(), std::ptrdiff_t(word.size())),
+            uint32_t(word.size()));
+    }
+
+    void updateCount(uint32_t word, uint64_t oldCount, uint64_t newCount)
+    {
+        if (oldCount == 0) {
+            ++liveWordCount;
+        }
+        if (newCount == 0) {
+            --liveWordCount;
+        }
+        bool wasRanked = (oldCount >= threshold);
+        bool isRanked = (newCount >= threshold);
+        if (!wasRanked && !isRanked) {
+            return;
+        }
+        uint64_t prefix = getWordPrefix(hashTable->arena.getWord(word));
+        if (!wasRanked) {
+            rank.insert({prefix, newCount, word});
+            return;
+        }
+        // the node is reused, so that a count change does not allocate
+        auto node = rank.extract({prefix, oldCount, word});
+        if (isRanked) {
+            node.value().count = newCount;
+            rank.insert(std::move(node));
+        }
+    }
+
+    // lowers the threshold by a scan of the table, once the ranked words are
+    // too few to be the top ones
+    void rerank()
+    {
+        std::vector<uint64_t> counts;
+        counts.reserve(liveWordCount);
+        hashTable->forEachWord([&counts](uint64_t count, uint32_t /*word*/) {
+            if (count != 0) {
+                counts.push_back(count);
+            }
+        });
+        threshold = 1;
+        if (counts.size() > candidateCount) {
+            auto nth = std::next(std::begin(counts),
+                                 std::ptrdiff_t(candidateCount - 1));
+            std::nth_element(std::begin(counts), nth, std::end(counts),
+                             std::greater<uint64_t>{});
+            threshold = *nth;
+        }
+        rank.clear();
+        hashTable->forEachWord([this](uint64_t count, uint32_t word) {
+            if ((count != 0) && (count >= threshold)) {
+                uint64_t prefix = getWordPrefix(hashTable->arena.getWord(word));
+                rank.insert({prefix, count, word});
+            }
+        });
+    }
+
+    // raises the threshold to the count of the last candidate, once counts
+    // grew, words of lesser counts are at the end of rank
+    void trimRank()
+    {
+        auto it = std::next(std::begin(rank), std::ptrdiff_t(candidateCount));
+        threshold = it->count;
+        while ((it != std::end(rank)) && (it->count >= threshold)) {
+            ++it;
+        }
+        rank.erase(it, std::end(rank));
+    }
+
+    // recounts words of nonzero count into the reset table, references in
+    // blocks and rank are updated; in time proportional to the number of such
+    // words, once per many blocks
+    void compact()
+    {
+        std::vector<char> words;
+        std::vector<std::pair<uint64_t, uint32_t>> counts;  // offsets in words
+        std::vector<uint32_t> hashes;
+        std::vector<uint32_t> oldWords;
+        counts.reserve(liveWordCount);
+        hashTable->forEachWord([&](uint64_t count, uint32_t word) {
+            if (count == 0) {
+                return;
+            }
+            auto w = hashTable->arena.getWord(word);
+            counts.emplace_back(count, uint32_t(words.size()));
+            words.insert(std::cend(words), std::cbegin(w), std::cend(w));
+            words.push_back('\0');  // for the key comparison of incCounter()
+            uint32_t hash = oaph::kInitialChecksum;
+            for (char c : w) {
+                hash = _mm_crc32_u8(hash, uint8_t(c));
+            }
+            hashes.push_back(hash);
+            oldWords.push_back(word);
+        });
+        std::vector<PrefixRankEntry<uint32_t>> rankEntries{std::cbegin(rank),
+                                                           std::cend(rank)};
+        rank.clear();
+        hashTable->reset();
+        deltaIndices.clear();
+        wordCount = 0;
+        std::unordered_map<uint32_t, uint32_t> newWords;
+        newWords.reserve(counts.size());
+        for (std::size_t i = 0; i < counts.size(); ++i) {
+            const auto & [count, offset] = counts[i];
+            const char * w = std::next(words.data(), offset);
+            auto len = uint32_t(std::string_view{w}.size());
+            uint32_t word = hashTable->incCounter(
+                hashes[i], std::next(w, len), len, count);
+            ++wordCount;
+            newWords.emplace(oldWords[i], word);
+        }
+        for (auto & entry : rankEntries) {
+            entry.word = newWords.at(entry.word);
+            rank.insert(std::cend(rank), entry);  // in the order of rank
+        }
+        for (auto & block : blocks) {
+            for (Delta & delta : block) {
+                delta.word = newWords.at(delta.word);
+            }
+        }
+    }
+};